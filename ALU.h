@@ -0,0 +1,164 @@
+#pragma once
+
+// 8XY* arithmetic and logic
+// What each 8XYN opcode does to VX, VY and VF, written against plain register
+// references so the scalar handlers and the lane interpreter (see Lanes.h) share a
+// single definition. VX, VY and VF may be the same register (8XF4, 8FF5...), so the
+// order of the reads and writes matters: under the legacy profile VF is written
+// before the operands are read, as the original handlers did it, and everywhere else
+// both operands are read first and VF is written last.
+
+#include "Types.h"
+#include "Quirks.h"
+
+// Store the value of register VY in register VX
+template <class Quirks>
+inline void Alu8XY0(BYTE& vx, BYTE& vy, BYTE&) {
+    vx = vy;
+}
+
+// Set VX to VX OR VY
+template <class Quirks>
+inline void Alu8XY1(BYTE& vx, BYTE& vy, BYTE& vf) {
+    vx |= vy;
+
+    // Quirk: the VIP did these through the same routine the carry came out of
+    if (Quirks::logicResetsVF) {
+        vf = 0;
+    }
+}
+
+// Set VX to VX AND VY
+template <class Quirks>
+inline void Alu8XY2(BYTE& vx, BYTE& vy, BYTE& vf) {
+    vx &= vy;
+    if (Quirks::logicResetsVF) {
+        vf = 0;
+    }
+}
+
+// Set VX to VX XOR VY
+template <class Quirks>
+inline void Alu8XY3(BYTE& vx, BYTE& vy, BYTE& vf) {
+    vx ^= vy;
+    if (Quirks::logicResetsVF) {
+        vf = 0;
+    }
+}
+
+// Add the value of register VY to register VX
+// Set VF to 01 if the sum doesn't fit in a byte, 00 otherwise
+// Quirk: legacy clears VF first, then sets it if VY > VX, then adds
+template <class Quirks>
+inline void Alu8XY4(BYTE& vx, BYTE& vy, BYTE& vf) {
+    if (Quirks::legacyArithmetic) {
+        vf = 0;
+
+        int xval = vx;
+        int yval = vy;
+
+        if (yval > xval) {
+            vf = 1;
+        }
+
+        vx += vy;
+        return;
+    }
+
+    int xval = vx;
+    int yval = vy;
+    vx = (BYTE)(xval + yval);
+    vf = xval + yval > 0xFF ? 1 : 0;
+}
+
+// Subtract contents of Register Y from Register X
+// Set VF to 00 if a borrow occurs
+// Set VF to 01 if a borrow does not occur
+// Quirk: legacy sets VF before reading VX and VY
+template <class Quirks>
+inline void Alu8XY5(BYTE& vx, BYTE& vy, BYTE& vf) {
+    if (Quirks::legacyArithmetic) {
+        vf = 1;
+
+        int xval = vx;
+        int yval = vy;
+
+        if (yval > xval) {
+            vf = 0;
+        }
+
+        vx = (BYTE)(xval - yval);
+        return;
+    }
+
+    int xval = vx;
+    int yval = vy;
+    vx = (BYTE)(xval - yval);
+    vf = yval > xval ? 0 : 1;
+}
+
+// Store the value of register VY shifted right one bit in register VX
+// Set register VF to the least significant bit prior to the shift
+// Quirk: CHIP-48 and SCHIP shift VX in place and ignore VY
+// Quirk: legacy sets VF first, then shifts VY in place and copies it to VX
+template <class Quirks>
+inline void Alu8XY6(BYTE& vx, BYTE& vy, BYTE& vf) {
+    int value = Quirks::shift == SHIFT_VX ? vx : vy;
+
+    // Get least significant bit
+    // Thanks https://stackoverflow.com/questions/6647783/check-value-of-least-significant-bit-lsb-and-most-significant-bit-msb-in-c-c
+    int LSB = value & 1;
+
+    if (Quirks::shift == SHIFT_LEGACY) {
+        vf = (BYTE)LSB;
+        vx = vy >>= 1;
+        return;
+    }
+    vx = (BYTE)(value >> 1);
+    vf = (BYTE)LSB;
+}
+
+// Set register VX to the value of VY minus VX
+// Set VF to 00 if a borrow occurs
+// Set VF to 01 if a borrow does not occur
+// Quirk: legacy sets VF first, the same way as 8XY5, then does VX -= VY
+template <class Quirks>
+inline void Alu8XY7(BYTE& vx, BYTE& vy, BYTE& vf) {
+    if (Quirks::legacyArithmetic) {
+        vf = 1;
+
+        int xval = vx;
+        int yval = vy;
+
+        if (yval > xval) {
+            vf = 0;
+        }
+
+        vx -= vy;
+        return;
+    }
+
+    int xval = vx;
+    int yval = vy;
+    vx = (BYTE)(yval - xval);
+    vf = xval > yval ? 0 : 1;
+}
+
+// Store the value of register VY shifted left one bit in register VX
+// Set register VF to the most significant bit prior to the shift
+// VY is unchanged!
+// Quirk: everything but the VIP shifts VX in place, and legacy sets VF before the shift
+template <class Quirks>
+inline void Alu8XYE(BYTE& vx, BYTE& vy, BYTE& vf) {
+
+    // Assign MSB to register VF, and store value of register VY shifted one bit to
+    // register VX.
+    if (Quirks::shift == SHIFT_LEGACY) {
+        vf = (BYTE)(vx >> 7);
+        vx <<= 1;
+        return;
+    }
+    int value = Quirks::shift == SHIFT_VY ? vy : vx;
+    vx = (BYTE)(value << 1);
+    vf = (BYTE)(value >> 7);
+}
@@ -0,0 +1,289 @@
+#include "Analyzer.h"
+#include <algorithm>
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Where control goes after an instruction, as far as the analysis is concerned.
+static bool IsSkip(BYTE kind) {
+    switch (kind) {
+        case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0: case OP_EX9E: case OP_EXA1:
+            return true;
+    }
+    return false;
+}
+
+static bool EndsBlock(BYTE kind) {
+    return kind == OP_00EE || kind == OP_1NNN || kind == OP_2NNN || kind == OP_BNNN || kind == OP_00FD || IsSkip(kind);
+}
+
+// XO-CHIP's F000 NNNN is the only four byte instruction, and skips step over all of it.
+static int InstructionLength(const std::vector<BYTE>& memory, int pc) {
+    return memory[pc] == 0xF0 && memory[pc + 1] == 0x00 ? 4 : 2;
+}
+
+void AnalyzeROM(const ROMImage& rom, ROMAnalysis& analysis) {
+    const Instruction* table = GetDecodeTable();
+    const size_t romSize = std::min(rom.Size(), (size_t)MAX_ROM_SIZE);
+
+    // The ROM as it'll sit in memory. Everything else reads as zero. Only the first 4K
+    // can hold code; anything past it is data whatever it looks like.
+    std::vector<BYTE> memory(MEMORY_SIZE, 0);
+    std::copy(rom.Data(), rom.Data() + romSize, memory.begin() + ROM_START_ADDRESS);
+
+    analysis.hash = rom.hash;
+    analysis.flags.assign(0x1000, 0);
+    analysis.decoded.assign(0x1000, table[0xFFFF]);
+    analysis.blocks.clear();
+    analysis.instructionCount = 0;
+    analysis.dataBytes = 0;
+    analysis.hasIndirectJumps = false;
+    std::vector<BYTE>& flags = analysis.flags;
+
+    // Walk everything reachable from the entry point.
+    std::vector<int> pending;
+    pending.push_back(ROM_START_ADDRESS);
+    flags[ROM_START_ADDRESS] |= ADDRESS_BLOCK_START;
+
+    auto branchTo = [&](int target, BYTE flag) {
+        target &= 0xFFF;
+        flags[target] |= flag | ADDRESS_BLOCK_START;
+        pending.push_back(target);
+    };
+
+    while (!pending.empty()) {
+        int pc = pending.back();
+        pending.pop_back();
+
+        while (pc + 1 < 0x1000 && !(flags[pc] & ADDRESS_CODE)) {
+            WORD opcode = (WORD)((memory[pc] << 8) | memory[pc + 1]);
+            const Instruction& ins = table[opcode];
+            flags[pc] |= ADDRESS_CODE;
+            flags[pc + 1] |= ADDRESS_CODE_TAIL;
+            analysis.decoded[pc] = ins;
+            analysis.instructionCount++;
+
+            if (ins.kind == OP_00EE || ins.kind == OP_00FD) {
+                break;
+            }
+            else if (ins.kind == OP_1NNN) {
+                branchTo(ins.nnn, ADDRESS_JUMP_TARGET);
+                break;
+            }
+            else if (ins.kind == OP_BNNN) {
+                flags[pc] |= ADDRESS_INDIRECT_JUMP;
+                analysis.hasIndirectJumps = true;
+                break;
+            }
+            else if (ins.kind == OP_2NNN) {
+                branchTo(ins.nnn, ADDRESS_CALL_TARGET);
+                flags[(pc + 2) & 0xFFF] |= ADDRESS_BLOCK_START;
+            }
+            else if (IsSkip(ins.kind)) {
+                branchTo(pc + 2 + InstructionLength(memory, (pc + 2) & 0xFFF), ADDRESS_JUMP_TARGET);
+                flags[(pc + 2) & 0xFFF] |= ADDRESS_BLOCK_START;
+            }
+            else if (ins.kind == OP_ANNN) {
+                flags[ins.nnn] |= ADDRESS_DATA_REFERENCE;
+            }
+            else if (ins.kind == OP_F000 && pc + 3 < 0x1000) {
+                flags[pc + 2] |= ADDRESS_CODE_TAIL;
+                flags[pc + 3] |= ADDRESS_CODE_TAIL;
+                pc += 2;
+            }
+            pc += 2;
+        }
+    }
+
+    // Cut the code into blocks at every leader and every control-flow instruction.
+    for (int start = 0; start + 1 < 0x1000; start++) {
+        if ((flags[start] & (ADDRESS_CODE | ADDRESS_BLOCK_START)) != (ADDRESS_CODE | ADDRESS_BLOCK_START)) {
+            continue;
+        }
+
+        BasicBlock block = {};
+        block.start = (WORD)start;
+        int pc = start;
+        for (;;) {
+            const Instruction& ins = analysis.decoded[pc];
+            int next = pc + (ins.kind == OP_F000 ? 4 : 2);
+
+            if (EndsBlock(ins.kind)) {
+                if (ins.kind == OP_1NNN) {
+                    block.successors[block.successorCount++] = ins.nnn;
+                }
+                else if (ins.kind == OP_2NNN) {
+                    block.successors[block.successorCount++] = ins.nnn;
+                    block.successors[block.successorCount++] = (WORD)(next & 0xFFF);
+                }
+                else if (IsSkip(ins.kind)) {
+                    block.successors[block.successorCount++] = (WORD)(next & 0xFFF);
+                    block.successors[block.successorCount++] = (WORD)((next + InstructionLength(memory, next & 0xFFF)) & 0xFFF);
+                }
+                block.indirect = ins.kind == OP_BNNN;
+                block.returns = ins.kind == OP_00EE;
+                pc = next;
+                break;
+            }
+
+            // Falls into the next block (or off the end of the code)
+            if (next + 1 >= 0x1000 || !(flags[next] & ADDRESS_CODE) || (flags[next] & ADDRESS_BLOCK_START)) {
+                if (next + 1 < 0x1000 && (flags[next] & ADDRESS_CODE)) {
+                    block.successors[block.successorCount++] = (WORD)next;
+                }
+                pc = next;
+                break;
+            }
+            pc = next;
+        }
+        block.end = (WORD)pc;
+        analysis.blocks.push_back(block);
+    }
+
+    for (size_t i = 0; i < romSize; i++) {
+        size_t address = ROM_START_ADDRESS + i;
+        if (address >= CODE_ADDRESS_LIMIT || !(flags[address] & (ADDRESS_CODE | ADDRESS_CODE_TAIL))) {
+            analysis.dataBytes++;
+        }
+    }
+}
+
+const ROMAnalysis* GetROMAnalysis(const ROMImage& rom) {
+    static std::mutex cacheMutex;
+    static std::unordered_map<uint64_t, std::unique_ptr<ROMAnalysis>> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::unique_ptr<ROMAnalysis>& analysis = cache[rom.hash];
+    if (!analysis) {
+        analysis.reset(new ROMAnalysis());
+        AnalyzeROM(rom, *analysis);
+    }
+    return analysis.get();
+}
+
+const char* DisassembleOpcode(WORD opcode, char* buffer, size_t size) {
+    const Instruction& ins = GetDecodeTable()[opcode];
+    const int x = ins.x, y = ins.y;
+
+    switch (ins.kind) {
+        case OP_00E0: snprintf(buffer, size, "CLS"); break;
+        case OP_00EE: snprintf(buffer, size, "RET"); break;
+        case OP_1NNN: snprintf(buffer, size, "JP 0x%03X", ins.nnn); break;
+        case OP_2NNN: snprintf(buffer, size, "CALL 0x%03X", ins.nnn); break;
+        case OP_3XNN: snprintf(buffer, size, "SE V%X, 0x%02X", x, ins.nn); break;
+        case OP_4XNN: snprintf(buffer, size, "SNE V%X, 0x%02X", x, ins.nn); break;
+        case OP_5XY0: snprintf(buffer, size, "SE V%X, V%X", x, y); break;
+        case OP_6XNN: snprintf(buffer, size, "LD V%X, 0x%02X", x, ins.nn); break;
+        case OP_7XNN: snprintf(buffer, size, "ADD V%X, 0x%02X", x, ins.nn); break;
+        case OP_8XY0: snprintf(buffer, size, "LD V%X, V%X", x, y); break;
+        case OP_8XY1: snprintf(buffer, size, "OR V%X, V%X", x, y); break;
+        case OP_8XY2: snprintf(buffer, size, "AND V%X, V%X", x, y); break;
+        case OP_8XY3: snprintf(buffer, size, "XOR V%X, V%X", x, y); break;
+        case OP_8XY4: snprintf(buffer, size, "ADD V%X, V%X", x, y); break;
+        case OP_8XY5: snprintf(buffer, size, "SUB V%X, V%X", x, y); break;
+        case OP_8XY6: snprintf(buffer, size, "SHR V%X, V%X", x, y); break;
+        case OP_8XY7: snprintf(buffer, size, "SUBN V%X, V%X", x, y); break;
+        case OP_8XYE: snprintf(buffer, size, "SHL V%X, V%X", x, y); break;
+        case OP_9XY0: snprintf(buffer, size, "SNE V%X, V%X", x, y); break;
+        case OP_ANNN: snprintf(buffer, size, "LD I, 0x%03X", ins.nnn); break;
+        case OP_BNNN: snprintf(buffer, size, "JP V0, 0x%03X", ins.nnn); break;
+        case OP_CXNN: snprintf(buffer, size, "RND V%X, 0x%02X", x, ins.nn); break;
+        case OP_DXYN: snprintf(buffer, size, "DRW V%X, V%X, %d", x, y, ins.n); break;
+        case OP_EX9E: snprintf(buffer, size, "SKP V%X", x); break;
+        case OP_EXA1: snprintf(buffer, size, "SKNP V%X", x); break;
+        case OP_FX07: snprintf(buffer, size, "LD V%X, DT", x); break;
+        case OP_FX0A: snprintf(buffer, size, "LD V%X, K", x); break;
+        case OP_FX15: snprintf(buffer, size, "LD DT, V%X", x); break;
+        case OP_FX18: snprintf(buffer, size, "LD ST, V%X", x); break;
+        case OP_FX1E: snprintf(buffer, size, "ADD I, V%X", x); break;
+        case OP_FX29: snprintf(buffer, size, "LD F, V%X", x); break;
+        case OP_FX33: snprintf(buffer, size, "LD B, V%X", x); break;
+        case OP_FX55: snprintf(buffer, size, "LD [I], V%X", x); break;
+        case OP_FX65: snprintf(buffer, size, "LD V%X, [I]", x); break;
+        case OP_00CN: snprintf(buffer, size, "SCD %d", ins.n); break;
+        case OP_00DN: snprintf(buffer, size, "SCU %d", ins.n); break;
+        case OP_00FB: snprintf(buffer, size, "SCR"); break;
+        case OP_00FC: snprintf(buffer, size, "SCL"); break;
+        case OP_00FD: snprintf(buffer, size, "EXIT"); break;
+        case OP_00FE: snprintf(buffer, size, "LOW"); break;
+        case OP_00FF: snprintf(buffer, size, "HIGH"); break;
+        case OP_DXY0: snprintf(buffer, size, "DRW V%X, V%X, 0", x, y); break;
+        case OP_FX30: snprintf(buffer, size, "LD HF, V%X", x); break;
+        case OP_FX75: snprintf(buffer, size, "LD R, V%X", x); break;
+        case OP_FX85: snprintf(buffer, size, "LD V%X, R", x); break;
+        case OP_5XY2: snprintf(buffer, size, "SAVE V%X - V%X", x, y); break;
+        case OP_5XY3: snprintf(buffer, size, "LOAD V%X - V%X", x, y); break;
+        case OP_F000: snprintf(buffer, size, "LD I, long"); break;
+        case OP_FN01: snprintf(buffer, size, "PLANE %d", x); break;
+        case OP_F002: snprintf(buffer, size, "AUDIO"); break;
+        case OP_FX3A: snprintf(buffer, size, "PITCH V%X", x); break;
+        default:
+            if ((opcode & 0xF000) == 0) {
+                snprintf(buffer, size, "SYS 0x%03X", opcode & 0x0FFF);
+            }
+            else {
+                snprintf(buffer, size, "DW 0x%04X", opcode);
+            }
+            break;
+    }
+    return buffer;
+}
+
+void DumpROMAnalysis(FILE* out, const ROMImage& rom, const ROMAnalysis& analysis) {
+    const size_t romSize = std::min(rom.Size(), (size_t)MAX_ROM_SIZE);
+    auto byteAt = [&](int address) -> BYTE {
+        int offset = address - (int)ROM_START_ADDRESS;
+        return offset >= 0 && offset < (int)romSize ? rom.Data()[offset] : 0;
+    };
+
+    fprintf(out, "; %s (%016" PRIx64 "): %d instructions in %d blocks, %d data bytes%s\n",
+            rom.path.c_str(), rom.hash, analysis.instructionCount, (int)analysis.blocks.size(),
+            analysis.dataBytes, analysis.hasIndirectJumps ? ", has indirect jumps" : "");
+
+    char text[32];
+    for (const BasicBlock& block : analysis.blocks) {
+        BYTE startFlags = analysis.flags[block.start];
+        fprintf(out, "\nblock %03X-%03X%s%s", block.start, block.end - 1,
+                (startFlags & ADDRESS_CALL_TARGET) ? " (subroutine)" : "",
+                block.returns ? " returns" : block.indirect ? " jumps indirectly" : "");
+        if (block.successorCount) {
+            fprintf(out, " ->");
+            for (int i = 0; i < block.successorCount; i++) {
+                fprintf(out, " %03X", block.successors[i]);
+            }
+        }
+        fprintf(out, "\n");
+
+        for (int pc = block.start; pc < block.end; pc += 2) {
+            WORD opcode = (WORD)((byteAt(pc) << 8) | byteAt(pc + 1));
+            if (opcode == 0xF000) {
+                snprintf(text, sizeof(text), "LD I, 0x%04X", (byteAt(pc + 2) << 8) | byteAt(pc + 3));
+                fprintf(out, "  %03X  %04X  %s\n", pc, opcode, text);
+                pc += 2;
+                continue;
+            }
+            fprintf(out, "  %03X  %04X  %s\n", pc, opcode, DisassembleOpcode(opcode, text, sizeof(text)));
+        }
+    }
+
+    // Everything the walk never reached, one byte to a line with a picture of its bits,
+    // which makes sprites easy to spot.
+    fprintf(out, "\ndata\n");
+    for (size_t i = 0; i < romSize; i++) {
+        int address = ROM_START_ADDRESS + (int)i;
+        BYTE flags = address < (int)CODE_ADDRESS_LIMIT ? analysis.flags[address] : 0;
+        if (flags & (ADDRESS_CODE | ADDRESS_CODE_TAIL)) {
+            continue;
+        }
+
+        BYTE value = byteAt(address);
+        char picture[9];
+        for (int bit = 0; bit < 8; bit++) {
+            picture[bit] = (value >> (7 - bit)) & 1 ? '#' : '.';
+        }
+        picture[8] = '\0';
+        fprintf(out, "  %04X  %02X  %s%s\n", address, value, picture,
+                (flags & ADDRESS_DATA_REFERENCE) ? "  <- I" : "");
+    }
+}
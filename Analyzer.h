@@ -0,0 +1,69 @@
+#pragma once
+
+// Static ROM analysis
+// Every ROM is walked once when it's loaded: starting at 0x200, every reachable
+// instruction is disassembled by following jumps, calls, returns and both sides of every
+// skip. What comes out is a control-flow graph of basic blocks, a code/data map of the
+// whole address space, and a pre-decoded Instruction for every code address.
+//
+// BNNN jumps to NNN + V0, which can't be known without running the ROM. Those get
+// flagged and their targets left unexplored, so anything only reachable through one
+// shows up as data.
+
+#include "Chip8.h"
+#include <cstdio>
+#include <vector>
+
+// Per-address flags in ROMAnalysis::flags
+enum AddressFlags : BYTE {
+    ADDRESS_CODE            = 1 << 0,   // first byte of a reachable instruction
+    ADDRESS_CODE_TAIL       = 1 << 1,   // second byte of one
+    ADDRESS_BLOCK_START     = 1 << 2,
+    ADDRESS_JUMP_TARGET     = 1 << 3,   // 1NNN or a skip lands here
+    ADDRESS_CALL_TARGET     = 1 << 4,   // 2NNN lands here
+    ADDRESS_DATA_REFERENCE  = 1 << 5,   // ANNN points here
+    ADDRESS_INDIRECT_JUMP   = 1 << 6,   // a BNNN
+};
+
+struct BasicBlock {
+    WORD start;
+    WORD end;                       // one past the last instruction
+
+    // Where control can go next: up to two of them (a skip), none for a return or an
+    // indirect jump. A call lists its target and the instruction after it.
+    WORD successors[2];
+    BYTE successorCount;
+    bool indirect;                  // ends in a BNNN
+    bool returns;                   // ends in a 00EE
+};
+
+struct ROMAnalysis {
+    uint64_t hash = 0;
+
+    // One entry per address in the 4K space
+    std::vector<BYTE> flags;
+    std::vector<Instruction> decoded;   // OP_Unknown everywhere that isn't code
+
+    // Sorted by start address
+    std::vector<BasicBlock> blocks;
+
+    int instructionCount = 0;
+    int dataBytes = 0;                  // ROM bytes not reached as code
+    bool hasIndirectJumps = false;
+
+    bool IsCode(int address) const { return (flags[address & 0xFFF] & ADDRESS_CODE) != 0; }
+};
+
+// Analyze a ROM as it would sit at 0x200.
+void AnalyzeROM(const ROMImage& rom, ROMAnalysis& analysis);
+
+// The analysis for a ROM, worked out the first time it's asked for and then kept for
+// as long as the process runs. LoadCH8ROM does this for every ROM it loads. Safe to call
+// from any thread.
+const ROMAnalysis* GetROMAnalysis(const ROMImage& rom);
+
+// Print the opcode as assembly, e.g. "LD V3, 0x1F". Returns buffer.
+const char* DisassembleOpcode(WORD opcode, char* buffer, size_t size);
+
+// Print every block with its disassembly and successors, then the data ranges.
+void DumpROMAnalysis(FILE* out, const ROMImage& rom, const ROMAnalysis& analysis);
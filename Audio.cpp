@@ -0,0 +1,96 @@
+#include "Audio.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
+
+// 32 samples at 48 kHz is about two thirds of a millisecond per callback.
+const int AUDIO_SAMPLE_RATE = 48000;
+const int AUDIO_BUFFER_SAMPLES = 32;
+
+// Loud enough to hear, quiet enough not to hurt
+const int16_t AUDIO_AMPLITUDE = 3000;
+
+static int GreatestCommonDivisor(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+AudioOutput::~AudioOutput() {
+    Close();
+}
+
+bool AudioOutput::Open(const std::atomic<bool>& gate, int toneHz) {
+    Close();
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        LOG_WARN("No audio: %s", SDL_GetError());
+        return false;
+    }
+
+    SDL_AudioSpec wanted;
+    memset(&wanted, 0, sizeof(wanted));
+    wanted.freq = AUDIO_SAMPLE_RATE;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples = AUDIO_BUFFER_SAMPLES;
+    wanted.callback = &AudioOutput::Callback;
+    wanted.userdata = this;
+
+    // Whatever the device can't do natively, SDL converts for us.
+    SDL_AudioSpec obtained;
+    m_Device = SDL_OpenAudioDevice(NULL, 0, &wanted, &obtained, 0);
+    if (m_Device == 0) {
+        LOG_WARN("Unable to open an audio device: %s", SDL_GetError());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+    LOG_DEBUG("Audio: %d Hz, %d samples per callback", obtained.freq, obtained.samples);
+
+    // A buffer of exactly whole cycles, so looping it never glitches
+    int divisor = GreatestCommonDivisor(AUDIO_SAMPLE_RATE, toneHz);
+    int length = AUDIO_SAMPLE_RATE / divisor;
+    int cycles = toneHz / divisor;
+    m_Wave.resize(length);
+    for (int i = 0; i < length; i++) {
+        bool high = ((int64_t)i * cycles * 2 / length) % 2 == 0;
+        m_Wave[i] = high ? AUDIO_AMPLITUDE : -AUDIO_AMPLITUDE;
+    }
+    m_Position = 0;
+    m_Gate = &gate;
+
+    SDL_PauseAudioDevice(m_Device, 0);
+    return true;
+}
+
+void AudioOutput::Close() {
+    if (m_Device != 0) {
+        SDL_CloseAudioDevice(m_Device);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        m_Device = 0;
+    }
+    m_Gate = nullptr;
+}
+
+void SDLCALL AudioOutput::Callback(void* userdata, Uint8* stream, int length) {
+    static_cast<AudioOutput*>(userdata)->Fill(reinterpret_cast<int16_t*>(stream), length / (int)sizeof(int16_t));
+}
+
+void AudioOutput::Fill(int16_t* samples, int count) {
+    if (!m_Gate || !m_Gate->load(std::memory_order_relaxed)) {
+        memset(samples, 0, count * sizeof(int16_t));
+        return;
+    }
+
+    const size_t length = m_Wave.size();
+    while (count > 0) {
+        int chunk = (int)std::min<size_t>(count, length - m_Position);
+        memcpy(samples, &m_Wave[m_Position], chunk * sizeof(int16_t));
+        samples += chunk;
+        count -= chunk;
+        m_Position = (m_Position + chunk) % length;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Audio backend
+// The beeper is a square wave, built once into a buffer that holds a whole number of
+// cycles so it loops seamlessly. SDL's audio callback copies from that buffer while
+// the sound timer is running and writes silence otherwise. The callback never
+// allocates, locks or blocks; all it reads from the emulation is a single atomic flag.
+
+#include <SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class AudioOutput {
+public:
+    AudioOutput() = default;
+    ~AudioOutput();
+    AudioOutput(const AudioOutput&) = delete;
+    AudioOutput& operator=(const AudioOutput&) = delete;
+
+    // Open the default output device and start playing. gate is read from the audio
+    // thread and must outlive this object (or the next Close()).
+    bool Open(const std::atomic<bool>& gate, int toneHz = 440);
+    void Close();
+
+    bool IsOpen() const { return m_Device != 0; }
+
+private:
+    static void SDLCALL Callback(void* userdata, Uint8* stream, int length);
+    void Fill(int16_t* samples, int count);
+
+    SDL_AudioDeviceID m_Device = 0;
+    const std::atomic<bool>* m_Gate = nullptr;
+
+    // Exactly tone / gcd(rate, tone) cycles of square wave
+    std::vector<int16_t> m_Wave;
+    size_t m_Position = 0;
+};
@@ -0,0 +1,374 @@
+// CHIP-8 Interpreter, batch build
+// Runs every ROM in a directory (searched recursively for .ch8 files) or listed in a
+// manifest for a fixed budget, spread across a thread pool, and streams one line of
+// results per ROM as each one finishes: instructions per second, how many opcodes
+// didn't decode, how it faulted if it did, and the final screen and state hashes.
+//
+//   CHIP-8-batch <directory | manifest> [--frames N] [--cycles N] [--ips N] [--threads N]
+//                [--dispatch M] [--quirks P] [--quirk-db FILE] [--seed N] [--no-idle-skip]
+//                [--format csv|json] [--out FILE]
+//
+// A manifest is a text file with one ROM path per line. Relative paths are relative to
+// the manifest itself, and anything after a '#' is ignored.
+
+#include "Chip8.h"
+#include "Runner.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+enum BatchFormat {
+    FORMAT_CSV,
+    FORMAT_JSON,
+};
+
+struct BatchOptions {
+    std::string corpus;
+    uint64_t frames = 600;
+    uint64_t instructionBudget = 0;
+    int instructionsPerSecond = 700;
+    int threads = 0;
+    DispatchMode dispatch = DefaultDispatchMode();
+    bool quirksGiven = false;
+    QuirkProfile quirks = QUIRKS_LEGACY;
+    std::string quirkDatabase = DEFAULT_QUIRK_DATABASE;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+    bool skipIdleLoops = !MachineProfiler::enabled;
+    BatchFormat format = FORMAT_CSV;
+    std::string outPath;
+};
+
+static void PrintBatchUsage() {
+    printf("Usage: CHIP-8-batch <directory | manifest> [options]\n");
+    printf("  --frames N      run each ROM for N 60 Hz frames (default 600)\n");
+    printf("  --cycles N      and for at most N instructions\n");
+    printf("  --ips N         instructions per second of emulated time (default 700)\n");
+    printf("  --threads N     worker threads (default: one per core)\n");
+    printf("  --dispatch M    switch, table, threaded or jit\n");
+    printf("  --quirks P      legacy, vip, chip48, schip or xochip (default: look each ROM up in the quirk database)\n");
+    printf("  --quirk-db FILE quirk database to look ROMs up in (default %s)\n", DEFAULT_QUIRK_DATABASE);
+    printf("  --seed N        seed for CXNN's random numbers (decimal, or hex with 0x)\n");
+    printf("  --no-idle-skip  run idle loops instruction by instruction instead of skipping them\n");
+    printf("  --format F      csv or json (default csv)\n");
+    printf("  --out FILE      write the results to FILE instead of stdout\n");
+}
+
+static bool ParseBatchArgs(int argc, char* argv[], BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--frames" && hasValue) {
+            options.frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--cycles" && hasValue) {
+            options.instructionBudget = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--ips" && hasValue) {
+            options.instructionsPerSecond = atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (arg == "--dispatch" && hasValue) {
+            if (!ParseDispatchMode(argv[++i], options.dispatch)) {
+                printf("Unknown dispatch mode %s. Use switch, table, threaded or jit.\n", argv[i]);
+                return false;
+            }
+        }
+        else if (arg == "--quirks" && hasValue) {
+            if (!ParseQuirkProfile(argv[++i], options.quirks)) {
+                printf("Unknown quirk profile %s. Use legacy, vip, chip48, schip or xochip.\n", argv[i]);
+                return false;
+            }
+            options.quirksGiven = true;
+        }
+        else if (arg == "--quirk-db" && hasValue) {
+            options.quirkDatabase = argv[++i];
+        }
+        else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--no-idle-skip") {
+            options.skipIdleLoops = false;
+        }
+        else if (arg == "--format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "csv") {
+                options.format = FORMAT_CSV;
+            }
+            else if (format == "json") {
+                options.format = FORMAT_JSON;
+            }
+            else {
+                printf("Unknown format %s. Use csv or json.\n", format.c_str());
+                return false;
+            }
+        }
+        else if (arg == "--out" && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else if (arg[0] != '-' && options.corpus.empty()) {
+            options.corpus = arg;
+        }
+        else {
+            printf("Unknown option %s\n", arg.c_str());
+            PrintBatchUsage();
+            return false;
+        }
+    }
+
+    if (options.corpus.empty()) {
+        PrintBatchUsage();
+        return false;
+    }
+    if (options.frames == 0) {
+        printf("Refusing to run forever: --frames must be at least 1.\n");
+        return false;
+    }
+    return true;
+}
+
+static bool HasROMExtension(const std::string& name) {
+    if (name.size() < 4) {
+        return false;
+    }
+    std::string extension = name.substr(name.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+    return extension == ".ch8";
+}
+
+static bool IsAbsolutePath(const std::string& path) {
+    return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+}
+
+// Every .ch8 file under directory, subdirectories included. Returns false if it isn't a directory.
+static bool FindROMs(const std::string& directory, std::vector<std::string>& paths) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    do {
+        std::string name = entry.cFileName;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = directory + "\\" + name;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            FindROMs(path, paths);
+        }
+        else if (HasROMExtension(name)) {
+            paths.push_back(path);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return false;
+    }
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = directory + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            FindROMs(path, paths);
+        }
+        else if (HasROMExtension(name)) {
+            paths.push_back(path);
+        }
+    }
+    closedir(dir);
+#endif
+    return true;
+}
+
+static bool LoadManifest(const std::string& fname, std::vector<std::string>& paths) {
+    std::ifstream manifest(fname);
+    if (!manifest) {
+        return false;
+    }
+
+    std::string base;
+    size_t slash = fname.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        base = fname.substr(0, slash + 1);
+    }
+
+    std::string line;
+    while (std::getline(manifest, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            continue;
+        }
+        line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+        paths.push_back(IsAbsolutePath(line) ? line : base + line);
+    }
+    return true;
+}
+
+// Quote a field for CSV if it needs it
+static std::string CSVField(const std::string& text) {
+    if (text.find_first_of(",\"\n") == std::string::npos) {
+        return text;
+    }
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// ROM paths can contain backslashes on Windows
+static std::string JSONString(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void WriteResult(FILE* out, BatchFormat format, bool first, const std::string& path,
+                        const MachineJob& job, const MachineResult& r) {
+    double ips = r.seconds > 0.0 ? r.instructions / r.seconds : 0.0;
+    const char* fault = job.rom ? MachineFaultName(r.fault) : "unreadable";
+    uint64_t romHash = job.rom ? job.rom->hash : 0;
+
+    if (format == FORMAT_CSV) {
+        fprintf(out, "%s,%016" PRIx64 ",%s,%s,%" PRIu64 ",%" PRIu64 ",%.6f,%.0f,%" PRIu64 ",%s,%03X,%016" PRIx64 ",%016" PRIx64 "\n",
+                CSVField(path).c_str(), romHash, QuirkProfileName(job.quirks), DispatchModeName(job.dispatch),
+                r.frames, r.instructions, r.seconds, ips, r.unknownOpcodes, fault, r.faultPC, r.displayHash, r.stateHash);
+    }
+    else {
+        fprintf(out, "%s  {\"rom\": \"%s\", \"rom_hash\": \"%016" PRIx64 "\", \"quirks\": \"%s\", \"dispatch\": \"%s\""
+                ", \"frames\": %" PRIu64 ", \"instructions\": %" PRIu64 ", \"seconds\": %.6f, \"ips\": %.0f"
+                ", \"unknown_opcodes\": %" PRIu64 ", \"fault\": \"%s\", \"fault_pc\": \"%03X\""
+                ", \"display_hash\": \"%016" PRIx64 "\", \"state_hash\": \"%016" PRIx64 "\"}",
+                first ? "" : ",\n", JSONString(path).c_str(), romHash, QuirkProfileName(job.quirks), DispatchModeName(job.dispatch),
+                r.frames, r.instructions, r.seconds, ips, r.unknownOpcodes, fault, r.faultPC, r.displayHash, r.stateHash);
+    }
+    fflush(out);
+}
+
+int main(int argc, char* argv[]) {
+    BatchOptions options;
+    if (!ParseBatchArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    // Sorted, so the same corpus always makes the same jobs
+    std::vector<std::string> paths;
+    if (!FindROMs(options.corpus, paths)) {
+        if (!LoadManifest(options.corpus, paths)) {
+            printf("%s is neither a directory nor a readable manifest\n", options.corpus.c_str());
+            return 1;
+        }
+    }
+    else {
+        std::sort(paths.begin(), paths.end());
+    }
+    if (paths.empty()) {
+        printf("No ROMs found in %s\n", options.corpus.c_str());
+        return 1;
+    }
+
+    QuirkDatabase database;
+    if (!options.quirksGiven) {
+        LoadQuirkDatabase(options.quirkDatabase, database);
+    }
+
+    // A ROM that won't load, or is too big for its profile, still gets a line in the
+    // results, marked unreadable.
+    std::vector<MachineJob> jobs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        MachineJob& job = jobs[i];
+        job.rom = LoadCH8ROM(paths[i].c_str());
+        job.frames = options.frames;
+        job.instructionBudget = options.instructionBudget;
+        job.instructionsPerSecond = options.instructionsPerSecond;
+        job.dispatch = options.dispatch;
+        job.seed = options.seed;
+        job.skipIdleLoops = options.skipIdleLoops;
+        job.quirks = options.quirks;
+        if (!options.quirksGiven && job.rom) {
+            job.quirks = LookupQuirkProfile(database, job.rom->hash, QUIRKS_LEGACY);
+        }
+        if (job.rom && !ROMFitsQuirkProfile(*job.rom, job.quirks)) {
+            job.rom = nullptr;
+        }
+    }
+
+    FILE* out = stdout;
+    if (!options.outPath.empty()) {
+        out = fopen(options.outPath.c_str(), "w");
+        if (!out) {
+            printf("Unable to write %s\n", options.outPath.c_str());
+            return 1;
+        }
+    }
+
+    if (options.format == FORMAT_CSV) {
+        fprintf(out, "rom,rom_hash,quirks,dispatch,frames,instructions,seconds,ips,unknown_opcodes,fault,fault_pc,display_hash,state_hash\n");
+    }
+    else {
+        fprintf(out, "[\n");
+    }
+
+    // Each line goes out as soon as its ROM finishes, so a long run can be watched (or piped) as it goes.
+    std::mutex outMutex;
+    size_t written = 0;
+    size_t faulted = 0;
+    size_t withUnknownOpcodes = 0;
+
+    ThreadPool pool(options.threads);
+    auto start = std::chrono::steady_clock::now();
+    RunMachines(jobs, pool, [&](size_t i, const MachineResult& result) {
+        std::lock_guard<std::mutex> lock(outMutex);
+        WriteResult(out, options.format, written == 0, paths[i], jobs[i], result);
+        written++;
+        faulted += (!jobs[i].rom || (result.fault != FAULT_NONE && result.fault != FAULT_EXIT)) ? 1 : 0;
+        withUnknownOpcodes += result.unknownOpcodes ? 1 : 0;
+    });
+    auto end = std::chrono::steady_clock::now();
+
+    if (options.format == FORMAT_JSON) {
+        fprintf(out, "\n]\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%zu ROMs in %.3f s on %d threads: %zu faulted or unreadable, %zu ran unknown opcodes\n",
+            written, std::chrono::duration<double>(end - start).count(), pool.ThreadCount(), faulted, withUnknownOpcodes);
+    return 0;
+}
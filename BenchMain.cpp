@@ -0,0 +1,474 @@
+// CHIP-8 Interpreter, benchmark build
+// Runs a set of synthetic ROMs (one per group of handlers) plus any real ROMs given on
+// the command line through every dispatch mode, and reports the results as JSON.
+//
+//   CHIP-8-bench [rom.ch8 ...] [--frames N] [--ips N] [--repeat N] [--dispatch M] [--seed N] [--lanes N] [--no-idle-skip] [--out FILE]
+//
+// --lanes also runs every ROM on a LaneGroup of 8, 16 or 32 lanes (see Lanes.h), each
+// lane seeded differently, and reports the instructions of all the lanes together.
+//
+// Instructions an idle loop skip fast-forwarded over (see Chip8::m_SkipIdleLoops) are
+// reported on their own, as idle_skipped, and left out of instructions and ips, so the
+// rates only ever count work that was actually done. --no-idle-skip runs them all.
+
+#include "Chip8.h"
+#include "Lanes.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every heap allocation in the process goes through here, so the benchmark can report
+// how many of them happen per frame. The emulation loop itself should need none.
+static std::atomic<uint64_t> s_Allocations(0);
+
+// The sized and array forms all come here too, so none of them slip past the count.
+void* operator new(size_t size) {
+    s_Allocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+// Just enough of an assembler to lay out the synthetic ROMs.
+class ROMBuilder {
+public:
+    WORD Here() const { return (WORD)(ROM_START_ADDRESS + code.size()); }
+
+    void Op(WORD opcode) {
+        code.push_back(opcode >> 8);
+        code.push_back(opcode & 0xFF);
+    }
+
+    void Ops(std::initializer_list<WORD> opcodes) {
+        for (WORD opcode : opcodes) {
+            Op(opcode);
+        }
+    }
+
+    std::vector<BYTE> code;
+};
+
+struct BenchROM {
+    std::string name;
+    std::unique_ptr<ROMImage> image;
+};
+
+static std::unique_ptr<ROMImage> MakeImage(const std::string& name, const std::vector<BYTE>& code) {
+    std::unique_ptr<ROMImage> image(new ROMImage());
+    image->path = name;
+    image->file.OpenMemory(code.data(), code.size());
+    image->hash = HashROMData(image->Data(), image->Size());
+    return image;
+}
+
+// 8XY* arithmetic and logic, back to back
+static std::vector<BYTE> BuildALUROM() {
+    ROMBuilder rom;
+    rom.Ops({ 0x6012, 0x6134, 0x6256, 0x6378 });
+    WORD loop = rom.Here();
+    rom.Ops({ 0x8011, 0x8122, 0x8233, 0x8304, 0x8015, 0x8106, 0x8217, 0x830E,
+              0x8010, 0x8124, 0x8235, 0x8307, 0x7001, 0x7103 });
+    rom.Op(0x1000 | loop);
+    return rom.code;
+}
+
+// Clears and font sprites drawn all over the screen
+static std::vector<BYTE> BuildDrawROM() {
+    ROMBuilder rom;
+    rom.Ops({ 0x6000, 0x6100, 0xA000 });
+    WORD loop = rom.Here();
+    rom.Ops({ 0x00E0, 0xD015, 0x7003, 0x7105, 0xD015, 0x7007, 0xD01F, 0x710B, 0xD015 });
+    rom.Op(0x1000 | loop);
+    return rom.code;
+}
+
+// FX55/FX65 block moves and FX33, all into a scratch area well away from the code
+static std::vector<BYTE> BuildMemoryROM() {
+    ROMBuilder rom;
+    rom.Ops({ 0x6011, 0x6122, 0x6233, 0x63FF });
+    WORD loop = rom.Here();
+    rom.Ops({ 0xA600, 0xFF55, 0xA600, 0xFF65, 0xA640, 0xF755, 0xA640, 0xF765,
+              0xA680, 0xF333, 0xA680, 0xF265, 0x7301 });
+    rom.Op(0x1000 | loop);
+    return rom.code;
+}
+
+// A chain of nested calls eight deep, then all the way back out
+static std::vector<BYTE> BuildCallROM() {
+    const int depth = 8;
+    ROMBuilder rom;
+    WORD loop = rom.Here();
+    WORD first = (WORD)(loop + 4);
+    rom.Op(0x2000 | first);
+    rom.Op(0x1000 | loop);
+    for (int d = 0; d < depth; d++) {
+        WORD next = (WORD)(rom.Here() + 4);
+        rom.Op(d + 1 < depth ? (0x2000 | next) : 0x7001);
+        rom.Op(0x00EE);
+    }
+    return rom.code;
+}
+
+// Conditional skips, taken and not taken
+static std::vector<BYTE> BuildBranchROM() {
+    ROMBuilder rom;
+    rom.Ops({ 0x6000, 0x6100 });
+    WORD loop = rom.Here();
+    rom.Ops({ 0x3000, 0x7201, 0x4001, 0x7301, 0x5010, 0x7401, 0x9010, 0x7501,
+              0x7001, 0x3180, 0x7102 });
+    rom.Op(0x1000 | loop);
+    return rom.code;
+}
+
+// Code that rewrites itself: every round flips an add between 5 and 9, storing through
+// an I past 4K that wraps back onto it, then does a store that wraps off the top of
+// memory. Every dispatch mode has to see each rewrite to end on the same state.
+static std::vector<BYTE> BuildSelfModifyROM() {
+    ROMBuilder rom;
+    rom.Ops({ 0x6074, 0x6105, 0x650C });
+    WORD target = rom.Here();
+    rom.Ops({ 0x7405, 0x8153, 0xAFFF });
+    for (int delta = target + 1; delta > 0; delta -= 0xFF) {
+        rom.Ops({ (WORD)(0x6200 | std::min(delta, 0xFF)), 0xF21E });
+    }
+    rom.Ops({ 0xF155, 0xAFFF, 0xF155 });
+    rom.Op(0x1000 | target);
+    return rom.code;
+}
+
+struct BenchResult {
+    std::string name;
+    DispatchMode dispatch;
+    int lanes = 1;
+    uint64_t frames = 0;
+    uint64_t instructions = 0;
+    uint64_t skipped = 0;
+    uint64_t allocations = 0;
+    double seconds = 0.0;
+    uint64_t stateHash = 0;
+    bool faulted = false;
+};
+
+struct BenchOptions {
+    uint64_t frames = 600;
+    uint64_t warmupFrames = 10;
+    int instructionsPerSecond = 3000000;
+    int repeat = 3;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+    bool allDispatchModes = true;
+    DispatchMode dispatch = DefaultDispatchMode();
+    int lanes = 0;
+    bool skipIdleLoops = !MachineProfiler::enabled;
+    std::string outPath;
+    std::vector<std::string> romPaths;
+};
+
+static BenchResult RunBenchmark(const std::string& name, const ROMImage& rom, DispatchMode dispatch, const BenchOptions& options) {
+    BenchResult best;
+    best.name = name;
+    best.dispatch = dispatch;
+
+    for (int attempt = 0; attempt < options.repeat; attempt++) {
+        std::unique_ptr<Chip8> machine(new Chip8());
+        machine->m_DispatchMode = dispatch;
+        machine->m_RandomSeed = options.seed;
+        machine->m_SkipIdleLoops = options.skipIdleLoops;
+        machine->CPUReset(rom);
+
+        FrameScheduler scheduler;
+        scheduler.Configure(options.instructionsPerSecond, true);
+        scheduler.Start();
+
+        // Let the JIT compile and any lazy allocations happen before the clock starts.
+        for (uint64_t frame = 0; frame < options.warmupFrames; frame++) {
+            machine->RunInstructions(scheduler.InstructionsThisFrame());
+            machine->TickTimers();
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.dispatch = dispatch;
+
+        uint64_t allocationsBefore = s_Allocations.load();
+        uint64_t skippedBefore = machine->m_SkippedInstructions;
+        auto start = std::chrono::steady_clock::now();
+        for (; result.frames < options.frames && machine->m_Fault == FAULT_NONE; result.frames++) {
+            result.instructions += machine->RunInstructions(scheduler.InstructionsThisFrame());
+            machine->TickTimers();
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.skipped = machine->m_SkippedInstructions - skippedBefore;
+        result.instructions -= result.skipped;
+
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.allocations = s_Allocations.load() - allocationsBefore;
+        result.stateHash = machine->HashState();
+        result.faulted = machine->m_Fault != FAULT_NONE;
+
+        if (attempt == 0 || result.seconds < best.seconds) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+// Same as RunBenchmark, with every lane of a LaneGroup running the ROM. Split-off lanes
+// use dispatch. The state hash covers every lane.
+template <int LANES>
+static BenchResult RunLaneBenchmark(const std::string& name, const ROMImage& rom, DispatchMode dispatch, const BenchOptions& options) {
+    BenchResult best;
+    best.name = name;
+    best.dispatch = dispatch;
+    best.lanes = LANES;
+
+    for (int attempt = 0; attempt < options.repeat; attempt++) {
+        std::unique_ptr<LaneGroup<LANES>> group(new LaneGroup<LANES>());
+        for (int lane = 0; lane < LANES; lane++) {
+            group->Lane(lane).m_DispatchMode = dispatch;
+            group->Lane(lane).m_RandomSeed = options.seed + lane;
+            group->Lane(lane).m_SkipIdleLoops = options.skipIdleLoops;
+        }
+        group->Reset(rom, QUIRKS_LEGACY);
+
+        FrameScheduler scheduler;
+        scheduler.Configure(options.instructionsPerSecond, true);
+        scheduler.Start();
+
+        for (uint64_t frame = 0; frame < options.warmupFrames; frame++) {
+            group->RunInstructions(scheduler.InstructionsThisFrame());
+            group->TickTimers();
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.dispatch = dispatch;
+        result.lanes = LANES;
+
+        // Counted per lane from the group, so lanes that fault stop adding up. Only lanes
+        // split off from the group run on their own and can skip idle loops.
+        uint64_t allocationsBefore = s_Allocations.load();
+        uint64_t ranBefore = group->LockstepInstructions() + group->ScalarInstructions();
+        uint64_t skippedBefore = 0;
+        for (int lane = 0; lane < LANES; lane++) {
+            skippedBefore += group->Lane(lane).m_SkippedInstructions;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (; result.frames < options.frames; result.frames++) {
+            group->RunInstructions(scheduler.InstructionsThisFrame());
+            group->TickTimers();
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.instructions = group->LockstepInstructions() + group->ScalarInstructions() - ranBefore;
+        for (int lane = 0; lane < LANES; lane++) {
+            result.skipped += group->Lane(lane).m_SkippedInstructions;
+        }
+        result.skipped -= skippedBefore;
+        result.instructions -= result.skipped;
+
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.allocations = s_Allocations.load() - allocationsBefore;
+        result.stateHash = 14695981039346656037ull;
+        for (int lane = 0; lane < LANES; lane++) {
+            result.stateHash = (result.stateHash ^ group->Lane(lane).HashState()) * 1099511628211ull;
+            result.faulted |= group->Lane(lane).m_Fault != FAULT_NONE;
+        }
+
+        if (attempt == 0 || result.seconds < best.seconds) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+static BenchResult RunLaneBenchmark(const std::string& name, const ROMImage& rom, DispatchMode dispatch, const BenchOptions& options) {
+    switch (options.lanes) {
+        case 8: return RunLaneBenchmark<8>(name, rom, dispatch, options);
+        case 16: return RunLaneBenchmark<16>(name, rom, dispatch, options);
+        default: return RunLaneBenchmark<32>(name, rom, dispatch, options);
+    }
+}
+
+static void WriteJSON(FILE* out, const BenchOptions& options, const std::vector<BenchResult>& results) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"frames\": %" PRIu64 ",\n", options.frames);
+    fprintf(out, "  \"instructions_per_second_emulated\": %d,\n", options.instructionsPerSecond);
+    fprintf(out, "  \"repeat\": %d,\n", options.repeat);
+    fprintf(out, "  \"idle_skip\": %s,\n", options.skipIdleLoops ? "true" : "false");
+    fprintf(out, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        double ips = r.seconds > 0.0 ? r.instructions / r.seconds : 0.0;
+        double nsPerInstruction = r.instructions ? r.seconds * 1e9 / r.instructions : 0.0;
+        double fps = r.seconds > 0.0 ? r.frames / r.seconds : 0.0;
+        double allocationsPerFrame = r.frames ? (double)r.allocations / r.frames : 0.0;
+
+        // ROM paths can contain backslashes on Windows
+        std::string name;
+        for (char c : r.name) {
+            if (c == '\\' || c == '"') {
+                name += '\\';
+            }
+            name += c;
+        }
+
+        fprintf(out, "    {\"name\": \"%s\", \"dispatch\": \"%s\", \"lanes\": %d, \"frames\": %" PRIu64 ", \"instructions\": %" PRIu64
+                ", \"idle_skipped\": %" PRIu64 ", \"seconds\": %.6f, \"ips\": %.0f, \"ns_per_instruction\": %.3f, \"fps\": %.1f"
+                ", \"allocations_per_frame\": %.3f, \"state_hash\": \"%016" PRIx64 "\", \"faulted\": %s}%s\n",
+                name.c_str(), DispatchModeName(r.dispatch), r.lanes, r.frames, r.instructions,
+                r.skipped, r.seconds, ips, nsPerInstruction, fps, allocationsPerFrame, r.stateHash,
+                r.faulted ? "true" : "false", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+static bool ParseBenchArgs(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--frames" && hasValue) {
+            options.frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--ips" && hasValue) {
+            options.instructionsPerSecond = atoi(argv[++i]);
+        }
+        else if (arg == "--repeat" && hasValue) {
+            options.repeat = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--dispatch" && hasValue) {
+            if (!ParseDispatchMode(argv[++i], options.dispatch)) {
+                printf("Unknown dispatch mode %s. Use switch, table, threaded or jit.\n", argv[i]);
+                return false;
+            }
+            options.allDispatchModes = false;
+        }
+        else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--lanes" && hasValue) {
+            options.lanes = atoi(argv[++i]);
+            if (options.lanes != 8 && options.lanes != 16 && options.lanes != 32) {
+                printf("--lanes takes 8, 16 or 32\n");
+                return false;
+            }
+        }
+        else if (arg == "--no-idle-skip") {
+            options.skipIdleLoops = false;
+        }
+        else if (arg == "--out" && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else if (arg[0] != '-') {
+            options.romPaths.push_back(arg);
+        }
+        else {
+            printf("Usage: CHIP-8-bench [rom.ch8 ...] [--frames N] [--ips N] [--repeat N] [--dispatch M] [--seed N] [--lanes N] [--no-idle-skip] [--out FILE]\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!ParseBenchArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    std::vector<BenchROM> roms;
+    roms.push_back({ "synthetic/alu", MakeImage("synthetic/alu", BuildALUROM()) });
+    roms.push_back({ "synthetic/draw", MakeImage("synthetic/draw", BuildDrawROM()) });
+    roms.push_back({ "synthetic/memory", MakeImage("synthetic/memory", BuildMemoryROM()) });
+    roms.push_back({ "synthetic/call", MakeImage("synthetic/call", BuildCallROM()) });
+    roms.push_back({ "synthetic/branch", MakeImage("synthetic/branch", BuildBranchROM()) });
+    roms.push_back({ "synthetic/selfmod", MakeImage("synthetic/selfmod", BuildSelfModifyROM()) });
+
+    std::vector<const ROMImage*> realROMs;
+    for (const std::string& path : options.romPaths) {
+        // Benchmarks run everything under the legacy profile.
+        const ROMImage* rom = LoadCH8ROM(path.c_str());
+        if (!rom || !ROMFitsQuirkProfile(*rom, QUIRKS_LEGACY)) {
+            return 1;
+        }
+        realROMs.push_back(rom);
+    }
+
+    std::vector<DispatchMode> modes;
+    if (options.allDispatchModes) {
+        modes.push_back(DISPATCH_SWITCH);
+        modes.push_back(DISPATCH_TABLE);
+        if (IsThreadedDispatchAvailable()) {
+            modes.push_back(DISPATCH_THREADED);
+        }
+        modes.push_back(DISPATCH_JIT);
+    }
+    else {
+        modes.push_back(options.dispatch);
+    }
+
+    std::vector<BenchResult> results;
+    for (DispatchMode mode : modes) {
+        for (const BenchROM& rom : roms) {
+            results.push_back(RunBenchmark(rom.name, *rom.image, mode, options));
+        }
+        for (const ROMImage* rom : realROMs) {
+            results.push_back(RunBenchmark(rom->path, *rom, mode, options));
+        }
+    }
+
+    // Lane groups once, with split-off lanes on the single-machine dispatch mode
+    if (options.lanes) {
+        DispatchMode mode = options.allDispatchModes ? DefaultDispatchMode() : options.dispatch;
+        for (const BenchROM& rom : roms) {
+            results.push_back(RunLaneBenchmark(rom.name, *rom.image, mode, options));
+        }
+        for (const ROMImage* rom : realROMs) {
+            results.push_back(RunLaneBenchmark(rom->path, *rom, mode, options));
+        }
+    }
+
+    FILE* out = stdout;
+    if (!options.outPath.empty()) {
+        out = fopen(options.outPath.c_str(), "w");
+        if (!out) {
+            printf("Unable to write %s\n", options.outPath.c_str());
+            return 1;
+        }
+    }
+    WriteJSON(out, options, results);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
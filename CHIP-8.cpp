@@ -9,788 +9,495 @@
 #include <iostream>
 #include <fstream>
 #include <array>
+#include <cstring>
+#include "Chip8.h"
+#include "Renderer.h"
+#include "Audio.h"
+#include "Scheduler.h"
+#include "Headless.h"
+#include "Snapshot.h"
+#include "Log.h"
+#include "Input.h"
+#include "Emulator.h"
 #pragma warning(disable:4996)
 
-// Documentation specifies that memory ranges from 0x000 -> 0x1FF, so negative values are not
-// needed. Opcodes are 1 word, or 2 bytes. 1 byte = 4 bits.
-// Rather than writing unsigned char or unsigned short int all the time, it's best to refer to
-// them as BYTE or WORD.
-typedef unsigned char BYTE;
-typedef unsigned short int WORD;
-
-// Memory, registers, and all that good stuff.
-std::array<BYTE, 0xFFF> m_GameMemory;
-std::array<BYTE, 16> m_Registers;
-std::array<BYTE, 16> m_Keyboard;
-WORD m_AddressI;
-WORD m_PC;
-std::vector<WORD> m_Stack;
-
-// Timers!
-uint8_t delayTimer;
-uint8_t soundTimer;
-
-// Screen dimensions and data
+// Starting window size. The window can be resized freely after that (see ScaleMode).
 const unsigned int SCALE = 25;
 const unsigned int SCREEN_WIDTH = 64 * SCALE;
 const unsigned int SCREEN_HEIGHT = 32 * SCALE;
 
-// Using normal C-arrays for now. Getting a memory address to an element in an
-// std::array is difficult.
-BYTE m_ScreenData[SCREEN_WIDTH][SCREEN_HEIGHT];
-
-//std::array<std::array<BYTE, SCREEN_HEIGHT>, SCREEN_WIDTH> m_ScreenData;
-
-// Font data
-const unsigned int numOfSprites = 16;
-const unsigned int numOfPixels = 5;
-BYTE m_FontData[numOfSprites][numOfPixels] = {
-    { 0xF0, 0x90, 0x90, 0x90, 0xF0 }, // 0
-    { 0x20, 0x60, 0x20, 0x20, 0x70 }, // 1
-    { 0xF0, 0x10, 0xF0, 0x80, 0xF0 }, // 2
-    { 0xF0, 0x10, 0xF0, 0x10, 0xF0 }, // 3
-    { 0x90, 0x90, 0xF0, 0x10, 0x10 }, // 4
-    { 0xF0, 0x80, 0xF0, 0x10, 0xF0 }, // 5
-    { 0xF0, 0x80, 0xF0, 0x90, 0xF0 }, // 6
-    { 0xF0, 0x10, 0x20, 0x40, 0x40 }, // 7
-    { 0xF0, 0x90, 0xF0, 0x90, 0xF0 }, // 8
-    { 0xF0, 0x90, 0xF0, 0x10, 0xF0 }, // 9
-    { 0xF0, 0x90, 0xF0, 0x90, 0x90 }, // A
-    { 0xE0, 0x90, 0xE0, 0x90, 0xE0 }, // B
-    { 0xF0, 0x80, 0x80, 0x80, 0xF0 }, // C
-    { 0xE0, 0x90, 0x90, 0x90, 0xE0 }, // D
-    { 0xF0, 0x80, 0xF0, 0x80, 0xF0 }, // E
-    { 0xF0, 0x80, 0xF0, 0x80, 0x80 }, // F
-};
-
-
-void CPUReset() {
-
-    // Initialize address memory to 0
-    // Program Counter starts at address 0x200
-    m_AddressI = 0;
-    m_PC = 0x200;
-
-    // Set registers, keyboard, and game memory to 0
-    std::fill(std::begin(m_Registers), std::end(m_Registers), 0);
-    std::fill(std::begin(m_Keyboard), std::end(m_Keyboard), 0);
-    std::fill(std::begin(m_GameMemory), std::end(m_GameMemory), 0);
-
-    // Load fonts in the first set of addresses before
-    // address 0x200, where the CHIP-8 programs begin
-    for (int i = 0; i < numOfSprites; i++) {
-        for (int j = 0; j < numOfPixels; j++) {
-
-            // Thanks to this post, I can insert 2D array elements into 1D!
-            // https://stackoverflow.com/questions/24333170/put-a-multidimensional-array-into-a-one-dimensional-array
-            m_GameMemory[i * numOfSprites + j] = m_FontData[i][j];
-        }
-        printf("\n");
-    }
-}
-
-// Read and store the contents of ROM in memory.
-bool LoadCH8ROM(const char* fname) {
-
-    std::fstream ROM;
-    ROM.open(fname, std::ios::in | std::ios::binary);
-
-    if (!ROM) {
-        printf("Error loading the ROM. This occurs if the file does not exist or the name does not exist.\n");
-        return false;
-    }
-
-    // Get length of ROM file
-    ROM.seekg(0, std::ios::end);
-    long bufferSize = ROM.tellg();
-    ROM.seekg(0, std::ios::beg);
-    //printf("Size of ROM file: %d\n", (int)bufferSize);
+// Graphics
 
-    // Allocate memory to the main buffer
-    char* buffer = new char[sizeof(char) * bufferSize];
+// Initialize SDL!
+bool initSDL(SDL_Window* &window, SDL_Renderer* &renderer) {
 
-    if (!buffer) {
-        printf("Error while allocating memory.\n");
+    // Initialize video subsystem
+    // Additional flags can be found here: https://wiki.libsdl.org/SDL_Init
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        LOG_ERROR("Unable to initialize SDL: %s", SDL_GetError());
         return false;
     }
+    // Load window, renderer, and main surface
+    else {
 
-    ROM.read(buffer, bufferSize);
-
-    // Load the contents of ROM into game memory
-    if (((0xFFF+1) - 0x200) > bufferSize) {
-        for (int i = 0; i < bufferSize; i++) {
-
-            // Load memory contents into addresses after 0x200
-            m_GameMemory[i + 0x200] = buffer[i];
-            //printf("Element %d: %08X\n", i, buffer[i]);
+        // More flags here: https://wiki.libsdl.org/SDL_WindowFlags
+        window = SDL_CreateWindow("CHIP-8 Interpreter by John Carlo Manuel", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                  SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+
+        // Presents wait for vsync. That only ever holds up this thread, never the emulation.
+        renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC) : nullptr;
+        if (!renderer) {
+            LOG_ERROR("Unable to create the window: %s", SDL_GetError());
+            return false;
         }
     }
-    else {
-        printf("ROM is too large. Please load another ROM file.\n");
-        return false;
-    }
-
-    ROM.close();
-    delete[] buffer;
-
-    return true;
-}
-
-int GetRegisterX(WORD opcode) {
-    int regx = opcode & 0x0F00;
-    return regx >> 8;
-}
-
-int GetRegisterY(WORD opcode) {
-    int regy = opcode & 0x00F0;
-    return regy >> 4;
-}
-
-// Fetching the next set of opcode instructions
-WORD GetNextOpcode() {
-    WORD res = 0;
-    res = m_GameMemory[m_PC];
-    res <<= 8;
-
-    // OR the bits from the next memory address to add them together.
-    res |= m_GameMemory[m_PC + 1];
-
-    // Increment twice b/c an opcode is 1 WORD long (2 bytes). Recall in the
-    // first few lines that variable res is making use of two memory addresses,
-    // which are 1 byte long. By increasing the PC with 2 bytes, this would fetch 
-    // the next instruction.
-    m_PC += 2;
-
-    return res;
-}
-
-// Opcode 0NNN is for specific computers that uses some unique
-// machine code. It would pause a CHIP-8 program, then call a
-// machine language subroutine at NNN. Thus, it's best if this opcode is left
-// unimplemented because it would cause unexpected results at NNN.
-
-// Clear the screen
-void Opcode00E0(WORD opcode) {
     
-    // Set every pixel to 0.
-    //std::fill(&m_ScreenData[0], &m_ScreenData[0] + SCREEN_WIDTH * SCREEN_HEIGHT, 0);
-    std::fill(m_ScreenData[0], m_ScreenData[0] + SCREEN_WIDTH * SCREEN_HEIGHT, 0);
-}
-
-// Return from a subroutine
-void Opcode00EE(WORD opcode) {
-    m_PC = m_Stack.back();
-    m_Stack.pop_back();
-}
-
-// Jump to address NNN
-void Opcode1NNN(WORD opcode) {
-    m_PC = opcode & 0x0FFF;
-}
-
-// Call subroutine at NNN
-void Opcode2NNN(WORD opcode) {
-    m_Stack.push_back(m_PC);
-    m_PC = opcode & 0x0FFF;
-}
-
-// Skips next instruction if VX == NN
-void Opcode3XNN(WORD opcode) {
-    int regx = GetRegisterX(opcode);
-    int nn = opcode & 0x00FF;
-    if (m_Registers[regx] == nn) {
-        m_PC += 2;
-    }
-}
-
-// Skips next instruction if VX != NN
-void Opcode4XNN(WORD opcode) {
-    int regx = GetRegisterX(opcode);
-    int nn = opcode & 0x00FF;
-    if (m_Registers[regx] != nn) {
-        m_PC += 2;
-    }
+    return true;
 }
 
-// Skips next instruction if VX == VY
-void Opcode5XY0(WORD opcode) {
-    if (m_Registers[GetRegisterX(opcode)] == m_Registers[GetRegisterY(opcode)]) {
+// Upload the rows that changed since the last upload and draw the screen. shownVersions
+// remembers which version of each row the texture holds. Returns false if nothing changed.
+bool DrawPixels(FrameRenderer& frameRenderer, const PublishedFrame& frame, uint32_t* shownVersions) {
+    const DisplayPlane& display = frame.display;
+    const int wordsPerRow = display.WordsPerRow();
+    bool uploaded = false;
 
-        // Skip to the next line of instruction.
-        m_PC += 2;
+    // 00FE/00FF switched resolution: start over with a texture of the new size.
+    if (display.width != frameRenderer.Width() || display.height != frameRenderer.Height()) {
+        if (!frameRenderer.Resize(display.width, display.height)) {
+            return false;
+        }
+        memset(shownVersions, 0xFF, DISPLAY_MAX_HEIGHT * sizeof(uint32_t));
     }
-}
-
-// Store number NN in register VX
-void Opcode6XNN(WORD opcode) {
-    int regx = GetRegisterX(opcode);
-    int nn = opcode & 0x00FF;
-    m_Registers[regx] = nn;
-}
-
-// Add the value NN to register VX
-void Opcode7XNN(WORD opcode) {
-    int nn = opcode & 0x00FF;
-    m_Registers[GetRegisterX(opcode)] += nn;
-}
-
-// Store the value of register VY in register VX
-void Opcode8XY0(WORD opcode) {
-    m_Registers[GetRegisterX(opcode)] = m_Registers[GetRegisterY(opcode)];
-}
-
-// Set VX to VX OR VY
-void Opcode8XY1(WORD opcode) {
-    m_Registers[GetRegisterX(opcode)] |= m_Registers[GetRegisterY(opcode)];
-}
-
-// Set VX to VX AND VY
-void Opcode8XY2(WORD opcode) {
-    m_Registers[GetRegisterX(opcode)] &= m_Registers[GetRegisterY(opcode)];
-}
 
-// Set VX to VX XOR VY
-void Opcode8XY3(WORD opcode) {
-    m_Registers[GetRegisterX(opcode)] ^= m_Registers[GetRegisterY(opcode)];
-}
-
-// Add the value of register VY to register VX
-// If register VY > register VX, set register VF to 1
-void Opcode8XY4(WORD opcode) {
-    m_Registers[0xF] = 0;
-
-    int xval = m_Registers[GetRegisterX(opcode)];
-    int yval = m_Registers[GetRegisterY(opcode)];
+    // Each run of consecutive changed rows is one texture lock.
+    int y = 0;
+    while (y < display.height) {
+        if (frame.rowVersions[y] == shownVersions[y]) {
+            y++;
+            continue;
+        }
+        int first = y;
+        while (y < display.height && frame.rowVersions[y] != shownVersions[y]) {
+            shownVersions[y] = frame.rowVersions[y];
+            y++;
+        }
 
-    if (yval > xval) {
-        m_Registers[0xF] = 1;
-    }
+        int pitch = 0;
+        uint32_t* pixels = frameRenderer.Lock(pitch, first, y - first);
+        if (!pixels) {
+            return false;
+        }
 
-    m_Registers[GetRegisterX(opcode)] += m_Registers[GetRegisterY(opcode)];
-}
+        // Assign each pixel their color, one packed display word at a time.
+        for (int row = first; row < y; row++) {
+            const uint64_t* displayRow = display.Row(row);
+            const uint64_t* secondRow = frame.secondPlane.Row(row);
+            uint32_t* out = pixels + (row - first) * pitch;
 
-// Subtract contents of Register Y from Register X
-// Set VF to 00 if a borrow occurs
-// Set VF to 01 if a borrow does not occur
-void Opcode8XY5(WORD opcode) {
-    m_Registers[0xF] = 1;
-    
-    int xval = m_Registers[GetRegisterX(opcode)];
-    int yval = m_Registers[GetRegisterY(opcode)];
+            for (int w = 0; w < wordsPerRow; w++) {
+                uint64_t bits = displayRow[w];
+                uint64_t secondBits = secondRow[w];
+                for (int x = 0; x < 64; x++, bits <<= 1, secondBits <<= 1) {
 
-    if (yval > xval) {
-        m_Registers[0xF] = 0;
+                    // Lit pixels are white, the rest are black (see FrameRenderer::palette).
+                    out[w * 64 + x] = frameRenderer.palette[(bits >> 63) | ((secondBits >> 63) << 1)];
+                }
+            }
+        }
+        frameRenderer.Unlock();
+        uploaded = true;
     }
 
-    m_Registers[GetRegisterX(opcode)] = xval - yval;
-}
-
-// Store the value of register VY shifted right one bit in register VX
-// Set register VF to the least significant bit prior to the shift
-void Opcode8XY6(WORD opcode) {
-    int yVal = m_Registers[GetRegisterY(opcode)];
+    if (uploaded) {
 
-    // Get least significant bit
-    // Thanks https://stackoverflow.com/questions/6647783/check-value-of-least-significant-bit-lsb-and-most-significant-bit-msb-in-c-c
-    int LSB = yVal & 1;
-
-    m_Registers[0xF] = LSB;
-    m_Registers[GetRegisterX(opcode)] = m_Registers[GetRegisterY(opcode)] >>= 1; 
-}
-
-// Set register VX to the value of VY minus VX
-// Set VF to 00 if a borrow occurs
-// Set VF to 01 if a borrow does not occur
-void Opcode8XY7(WORD opcode) {
-    m_Registers[0xF] = 1;
-
-    int xval = m_Registers[GetRegisterX(opcode)];
-    int yval = m_Registers[GetRegisterY(opcode)];
-
-    if (yval > xval) {
-        m_Registers[0xF] = 0;
+        // Let the GPU scale the texture up to the window.
+        frameRenderer.Draw();
     }
+    return uploaded;
+}
+
+// The original layout: the number keys and A-F map straight onto the hex keypad.
+static const struct {
+    SDL_Keycode keycode;
+    BYTE key;
+} DEFAULT_KEY_BINDINGS[] = {
+    { SDLK_0, 0x0 }, { SDLK_1, 0x1 }, { SDLK_2, 0x2 }, { SDLK_3, 0x3 },
+    { SDLK_4, 0x4 }, { SDLK_5, 0x5 }, { SDLK_6, 0x6 }, { SDLK_7, 0x7 },
+    { SDLK_8, 0x8 }, { SDLK_9, 0x9 }, { SDLK_a, 0xA }, { SDLK_b, 0xB },
+    { SDLK_c, 0xC }, { SDLK_d, 0xD }, { SDLK_e, 0xE }, { SDLK_f, 0xF },
+};
 
-    m_Registers[GetRegisterX(opcode)] -= m_Registers[GetRegisterY(opcode)];
-}
-
-// Store the value of register VY shifted left one bit in register VX
-// Set register VF to the most significant bit prior to the shift
-// VY is unchanged!
-void Opcode8XYE(WORD opcode) {
-
-    // Assign MSB to register VF, and store value of register VY shifted one bit to
-    // register VX.
-    m_Registers[0xF] = m_Registers[GetRegisterX(opcode)] >> 7;
-    m_Registers[GetRegisterX(opcode)] <<= 1;
-}
-
-// Skip the following instruction if the value of register VX is not equal to the value of register VY
-void Opcode9XY0(WORD opcode) {
-    if (m_Registers[GetRegisterX(opcode)] != m_Registers[GetRegisterY(opcode)]) {
-        m_PC += 2;
+// Rebind keys from a file with one "<hex key> <SDL key name>" per line, e.g. "5 W" or
+// "0 Keypad 0". Lines starting with # are ignored. Bindings are added on top of the defaults.
+bool LoadKeyMap(const char* fname, KeyMap& keyMap) {
+    std::ifstream file(fname);
+    if (!file) {
+        LOG_ERROR("Unable to open key map %s", fname);
+        return false;
     }
-}
-
-// Store memory address NNN in register I
-void OpcodeANNN(WORD opcode) {
-    int nnn = opcode & 0x0FFF;
-    m_AddressI = nnn;
-}
-
-// Jump to address NNN + V0
-void OpcodeBNNN(WORD opcode) {
-    int nnn = opcode & 0x0FFF;
-    m_PC = nnn + m_Registers[0x0];
-}
 
-// Set VX to a random number with a mask of NN
-void OpcodeCXNN(WORD opcode) {
-    int nn = opcode & 0x00FF;
-    m_Registers[GetRegisterX(opcode)] = rand() & nn;
-}
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t split = line.find(' ');
+        if (line.empty() || line[0] == '#' || split == std::string::npos) {
+            continue;
+        }
 
-// Draw sprite at coord (VX, VY) with width of 8 pixels and N bytes.
-// Set VF to 01 if any set pixels are changed to unset, and 00 otherwise
-// Carry flags are determined in function DrawPixels.
-void OpcodeDXYN(WORD opcode) {
-
-    // Get the height of an arbitrary sprite
-    // No need to set a width because all sprites
-    // are 8 pixels wide.
-    int height = opcode & 0x000F;
-
-    // Coords start at top left of the screen
-    // These will the locations of the sprite drawn on
-    // screen
-    int coordx = m_Registers[GetRegisterX(opcode)];
-    int coordy = m_Registers[GetRegisterY(opcode)];
-
-    // Loop for each vertical line
-    for (int yline = 0; yline < height;  yline++) {
-
-        // Game memory stores sprite data here
-        BYTE data = m_GameMemory[m_AddressI + yline];
-
-        // Each byte is one line of the sprite. Each pixel determines
-        // whether it is on or off.
-        // xpixelinv is the xpixel reversed. Sprite data is encoded weird.
-        // For instance, pixel 0 = bit 7; pixel 1 = bit 6... pixel 7 = bit 0.
-        // When iterating through the pixels in the later lines, 
-        // xpixelinv will decrement while xpixel will increment. This will be 
-        // the method for traversing through the sprite data.
-        int xpixelinv = 7;
-        int xpixel = 0;
-
-        // Iterate through the sprite data.
-        for (xpixel = 0; xpixel < 8; xpixel++, xpixelinv--) {
-
-            int mask = 1 << xpixelinv;
-
-            // Determine if xpixelinv is 0 or 1 by checking the data and mask.
-            // If xpixelinv is 1, toggle the pixel state, else ignore.
-            if (data & mask) {
-
-                // Get the coords by adding registers VX/VY to width/height of pixel
-                int x = coordx + xpixel;
-                int y = coordy + yline;
-
-                // Toggle pixel state
-                m_ScreenData[x][y] ^= 1;
-            }
+        BYTE key = (BYTE)strtoul(line.substr(0, split).c_str(), nullptr, 16);
+        SDL_Keycode keycode = SDL_GetKeyFromName(line.substr(split + 1).c_str());
+        if (keycode == 0 || !keyMap.Bind(keycode, key)) {
+            LOG_ERROR("%s:%d: can't bind \"%s\"", fname, lineNumber, line.c_str());
+            return false;
         }
     }
+    return true;
 }
 
-// Skips next instruction if key in VX is pressed
-void OpcodeEX9E(WORD opcode) {
-    if (m_Registers[GetRegisterX(opcode)] == m_Keyboard[GetRegisterX(opcode)]) {
-        m_PC += 2;
+// Read up to four comma separated RRGGBB colors over the palette, in the same order as
+// FrameRenderer::palette: off, first plane, second plane, both planes.
+bool ParsePalette(const char* list, uint32_t* palette) {
+    std::string colors = list;
+    size_t start = 0;
+    for (int i = 0; i < 4 && start <= colors.size(); i++) {
+        size_t end = colors.find(',', start);
+        std::string color = colors.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        char* rest = nullptr;
+        unsigned long rgb = strtoul(color.c_str(), &rest, 16);
+        if (color.size() != 6 || *rest != '\0') {
+            return false;
+        }
+        palette[i] = (uint32_t)(rgb << 8) | 0xFF;
+        if (end == std::string::npos) {
+            return true;
+        }
+        start = end + 1;
     }
+    return false;
 }
 
-// Skips next instruction if key in VX is not pressed
-void OpcodeEXA1(WORD opcode) {
-    if (m_Registers[GetRegisterX(opcode)] != m_Keyboard[GetRegisterX(opcode)]) {
-        m_PC += 2;
+// Keys that aren't bound to the keypad may still mean something to the frontend.
+// F1 dumps the profile, F3 shows the speed overlay, F5 saves, F9 loads, Tab toggles
+// turbo and Backspace rewinds about half a second.
+void HandleHotkey(SDL_Keycode keycode, EmulationThread& emulator, bool& showOverlay) {
+    switch (keycode) {
+        case SDLK_F1:
+            emulator.Post(COMMAND_DUMP_PROFILE);
+            break;
+        case SDLK_F3:
+            showOverlay = !showOverlay;
+            break;
+        case SDLK_TAB:
+            emulator.Post(COMMAND_TOGGLE_TURBO);
+            break;
+        case SDLK_F5:
+            emulator.Post(COMMAND_QUICK_SAVE);
+            break;
+        case SDLK_F9:
+            emulator.Post(COMMAND_QUICK_LOAD);
+            break;
+        case SDLK_BACKSPACE:
+            emulator.Post(COMMAND_REWIND);
+            break;
+        default:
+            LOG_DEBUG("no other actions after pressing any key");
     }
 }
 
-// Store the current value of the delay timer in register VX
-void OpcodeFX07(WORD opcode) {
-    m_Registers[GetRegisterX(opcode)] = delayTimer;
-}
-
-// Set the delay timer to the value of register VX
-void OpcodeFX15(WORD opcode) {
-    delayTimer = m_Registers[GetRegisterX(opcode)];
-}
-
-// Set the sound timer to the value of register VX
-void OpcodeFX18(WORD opcode) {
-    soundTimer = m_Registers[GetRegisterX(opcode)];
-}
-
-// Add the value stored in register VX to register I
-void OpcodeFX1E(WORD opcode) {
-    m_AddressI += m_Registers[GetRegisterX(opcode)];
-}
-
-// Wait for a keypress and store the result in register VX
-void OpcodeFX0A(WORD opcode) {
-    bool keyPressed = false;
+// The humble beginnings of a C++ program
+int main(int argc, char* argv[]) {
 
-    for (int i = 0; i < sizeof(m_Keyboard); i++) {
-        if (m_Keyboard[i] != 0) {
-            m_Registers[GetRegisterX(opcode)] = i;
-            keyPressed = true;
+    // --headless runs the core without ever touching SDL. See Headless.h for its options.
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--headless") {
+            HeadlessOptions options;
+            if (!ParseHeadlessArgs(argc, argv, options)) {
+                return 1;
+            }
+            return RunHeadless(options);
         }
     }
-}
-
-// Set register I to the memory address of the sprite data corresponding to 
-// the hexadecimal digit stored in register VX
-void OpcodeFX29(WORD opcode) {
-    int regx = m_Registers[GetRegisterX(opcode)];
-    m_AddressI = *m_ScreenData[regx];
-}
-
-// Store Binary-coded decimal in register VX
-void OpcodeFX33(WORD opcode) {
-    int value = m_Registers[GetRegisterX(opcode)];
-
-    int hundreds = value / 100;
-    int tens = (value / 10) % 10;
-    int units = value % 10;
-
-    m_GameMemory[m_AddressI] = hundreds;
-    m_GameMemory[m_AddressI + 1] = tens;
-    m_GameMemory[m_AddressI + 2] = units;
-}
-
-// Stores V0 to VX in memory starting at address I
-void OpcodeFX55(WORD opcode) {
-    int regx = GetRegisterX(opcode);
-    for (int i = 0; i <= regx; i++) {
-        m_GameMemory[m_AddressI + i] = m_Registers[i];
-    }
-    m_AddressI = m_AddressI + regx + 1;
-}
 
-// Fills V0 to VX with values from memory starting at address I
-void OpcodeFX65(WORD opcode) {
-    int xval = GetRegisterX(opcode);
-    for (int i = 0; i <= xval; i++) {
-        m_Registers[i] = m_GameMemory[m_AddressI + i];
+    // Speed options:
+    //   --ips N       run N instructions per second (default 700)
+    //   --unbounded   don't wait for the 60 Hz deadlines, run as fast as possible
+    //   --dispatch M  switch, table, threaded or jit (see DispatchMode in Chip8.h)
+    //   --keymap F    rebind keys from a file (see LoadKeyMap)
+    //   --seed N      seed for CXNN's random numbers, so a run can be repeated exactly
+    //   --quirks P    legacy, vip, chip48, schip or xochip (default: look the ROM up in ROMS/quirks.txt, see Quirks.h)
+    //   --record F    save the session as an input movie, to play back with --headless --movie F (see Movie.h)
+    //   --turbo N     how many times faster Tab runs the machine (default 8)
+    //   --frame-skip K  show at most every Kth frame (times the turbo speed while in turbo)
+    //   --no-idle-skip  run idle loops instruction by instruction (see Chip8::m_SkipIdleLoops)
+    //   --debug-port N  serve a debugger on 127.0.0.1:N (see Debugger.h)
+    //   --export F    keep the machine's state mapped into F for dashboards (see StateExport.h)
+    //   --overlay     start with the IPS/FPS overlay showing (F3 toggles it)
+    //   --scale M     stretch, fit (default), integer or crt (see ScaleMode in Renderer.h)
+    //   --palette C   up to four RRGGBB colors: off, first plane, second plane, both
+    Chip8 machine;
+    FrameScheduler scheduler;
+    InputQueue inputQueue;
+    KeyMap keyMap;
+    for (const auto& binding : DEFAULT_KEY_BINDINGS) {
+        keyMap.Bind(binding.keycode, binding.key);
     }
-    m_AddressI = m_AddressI + xval + 1;
-}
-
-// Starts the opcode decoding cycle
-void DecodeOpcodeCycle(WORD opcode) {
-    switch (opcode & 0xF000) {
-        case 0x0000: {
-            switch (opcode & 0x000F) {
-                case 0x0000: Opcode00E0(opcode); break;
-                case 0x000E: Opcode00EE(opcode); break;
-            }
-        } break;
-        case 0x1000: Opcode1NNN(opcode); break;
-        case 0x2000: Opcode2NNN(opcode); break;
-        case 0x3000: Opcode3XNN(opcode); break;
-        case 0x4000: Opcode4XNN(opcode); break;
-        case 0x5000: Opcode5XY0(opcode); break;
-        case 0x6000: Opcode6XNN(opcode); break;
-        case 0x7000: Opcode7XNN(opcode); break;
-        case 0x8000: {
-            switch (opcode & 0x000F) {
-                case 0x0000: Opcode8XY0(opcode); break;
-                case 0x0001: Opcode8XY1(opcode); break;
-                case 0x0002: Opcode8XY2(opcode); break;
-                case 0x0003: Opcode8XY3(opcode); break;
-                case 0x0004: Opcode8XY4(opcode); break;
-                case 0x0005: Opcode8XY5(opcode); break;
-                case 0x0006: Opcode8XY6(opcode); break;
-                case 0x0007: Opcode8XY7(opcode); break;
-                case 0x000E: Opcode8XYE(opcode); break;
+    int instructionsPerSecond = 700;
+    bool unbounded = false;
+    bool quirksGiven = false;
+    int turboSpeed = 8;
+    int frameSkip = 1;
+    bool showOverlay = false;
+    ScaleMode scaleMode = SCALE_FIT;
+    uint32_t palette[4];
+    memcpy(palette, FrameRenderer().palette, sizeof(palette));
+    std::string recordPath;
+    int debugPort = 0;
+    std::string exportPath;
+    std::string path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--ips" && i + 1 < argc) {
+            instructionsPerSecond = atoi(argv[++i]);
+        }
+        else if (arg == "--unbounded") {
+            unbounded = true;
+        }
+        else if (arg == "--dispatch" && i + 1 < argc) {
+            if (!ParseDispatchMode(argv[++i], machine.m_DispatchMode)) {
+                printf("Unknown dispatch mode %s. Use switch, table, threaded or jit.\n", argv[i]);
+                return 1;
             }
-        } break;
-        case 0x9000: Opcode9XY0(opcode); break;
-        case 0xA000: OpcodeANNN(opcode); break;
-        case 0xB000: OpcodeBNNN(opcode); break;
-        case 0xC000: OpcodeCXNN(opcode); break;
-        case 0xD000: OpcodeDXYN(opcode); break;
-        case 0xE000: {
-            switch (opcode & 0x00FF) {
-                case 0x009E: OpcodeEX9E(opcode); break;
-                case 0x00A1: OpcodeEXA1(opcode); break;
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            machine.m_RandomSeed = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--quirks" && i + 1 < argc) {
+            if (!ParseQuirkProfile(argv[++i], machine.m_Quirks)) {
+                printf("Unknown quirk profile %s. Use legacy, vip, chip48, schip or xochip.\n", argv[i]);
+                return 1;
             }
-        } break;
-        case 0xF000: {
-            switch (opcode & 0x00FF) {
-                case 0x0007: OpcodeFX07(opcode); break;
-                case 0x000A: OpcodeFX0A(opcode); break;
-                case 0x0015: OpcodeFX15(opcode); break;
-                case 0x0018: OpcodeFX18(opcode); break;
-                case 0x001E: OpcodeFX1E(opcode); break;
-                case 0x0029: OpcodeFX29(opcode); break;
-                case 0x0033: OpcodeFX33(opcode); break;
-                case 0x0055: OpcodeFX55(opcode); break;
-                case 0x0065: OpcodeFX65(opcode); break;
+            quirksGiven = true;
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--turbo" && i + 1 < argc) {
+            turboSpeed = atoi(argv[++i]);
+        }
+        else if (arg == "--frame-skip" && i + 1 < argc) {
+            frameSkip = atoi(argv[++i]);
+        }
+        else if (arg == "--debug-port" && i + 1 < argc) {
+            debugPort = atoi(argv[++i]);
+        }
+        else if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        }
+        else if (arg == "--no-idle-skip") {
+            machine.m_SkipIdleLoops = false;
+        }
+        else if (arg == "--overlay") {
+            showOverlay = true;
+        }
+        else if (arg == "--scale" && i + 1 < argc) {
+            if (!ParseScaleMode(argv[++i], scaleMode)) {
+                printf("Unknown scale mode %s. Use stretch, fit, integer or crt.\n", argv[i]);
+                return 1;
             }
-        } break;
-        default: 
-            printf("No additional opcodes from this ROM.");
-            break;
-    };
-
-    // If delay timer is bigger than 0, decrement
-    if (delayTimer > 0) {
-        delayTimer--;
-    }
-
-    // Same as delay timer, but if it is above 0, play a beeping sound
-    if (soundTimer > 0) {
-        printf("Beeping sound");
-        soundTimer--;
-    }
-}
-
-// Graphics
-
-// Initialize SDL!
-bool initSDL(SDL_Window* &window, SDL_Renderer* &renderer) {
-
-    // Initialize video subsystem
-    // Additional flags can be found here: https://wiki.libsdl.org/SDL_Init
-    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-        printf("Unable to initialize SDL: %s", SDL_GetError());
-        return false;
-    }
-    // Load window, renderer, and main surface
-    else {
-
-        // More flags here: https://wiki.libsdl.org/SDL_WindowFlags
-        SDL_CreateWindowAndRenderer(SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN, &window, &renderer);
-        SDL_SetWindowTitle(window, "CHIP-8 Interpreter by John Carlo Manuel");
-    }
-    
-    return true;
-}
-
-// Draw and render the pixels in SDL
-void DrawPixels(SDL_Renderer* &renderer, SDL_Texture* &gameScreen) {
-    
-    // Set game screen to be a texture with RGBA8888 format.
-    // Because the CHIP-8 is developed in a big endian fashion,
-    // this format is the most suited candidate.
-    // Read more about this: https://en.wikipedia.org/wiki/RGBA_color_model
-    gameScreen = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
-
-    if (!gameScreen) {
-        printf("gameScreen cannot be loaded. See more: %s\n", SDL_GetError());
-    }
-
-    if (SDL_SetRenderTarget(renderer, gameScreen) != 0) {
-        printf("Error: Render target is not equal to 0. Here's the complete message: %s\n", SDL_GetError());
-    }
-
-    // Assign each pixel their color
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            if (m_ScreenData[x][y] == 0) {
-
-                // If the pixel is 0, color it black.
-                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        }
+        else if (arg == "--palette" && i + 1 < argc) {
+            if (!ParsePalette(argv[++i], palette)) {
+                printf("Bad palette %s. Use up to four RRGGBB colors separated by commas.\n", argv[i]);
+                return 1;
             }
-            else if (m_ScreenData[x][y] == 1) {
-
-                // If the pixel is 1, color it white.
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-                m_Registers[0xF] = 1;
+        }
+        else if (arg == "--keymap" && i + 1 < argc) {
+            if (!LoadKeyMap(argv[++i], keyMap)) {
+                return 1;
             }
-            
-            SDL_RenderDrawPoint(renderer, x, y);
+        }
+        else if (arg[0] != '-' && path.empty()) {
+            path = arg;
         }
     }
-
-    // Create a rect with the dimensions of the application window,
-    // then fill this rect with the gameScreen texture. This is
-    // another way to render the pixels onto the screen.
-    SDL_SetRenderTarget(renderer, NULL);
-    SDL_Rect tempRect;
-    tempRect.x = 0;
-    tempRect.y = 0;
-    tempRect.w = SCREEN_WIDTH*SCALE;
-    tempRect.h = SCREEN_HEIGHT*SCALE;
-    SDL_RenderCopy(renderer, gameScreen, NULL, &tempRect);
-}
-
-// The humble beginnings of a C++ program
-int main(int argc, char* argv[]) {
-    std::string fname, path;
-    std::cout << "Enter filename inside your ROMS folder without file extension: " << '\n';
-    std::cin >> fname;
-    std::string fileExtension = ".ch8";
-    std::string folderPath = "ROMS/";
-    path = folderPath + fname + fileExtension;
+    scheduler.Configure(instructionsPerSecond, unbounded);
+
+    // Without a ROM on the command line, ask for one from the ROMS folder.
+    if (path.empty()) {
+        std::string fname;
+        std::cout << "Enter filename inside your ROMS folder without file extension: " << '\n';
+        std::cin >> fname;
+        std::string fileExtension = ".ch8";
+        std::string folderPath = "ROMS/";
+        path = folderPath + fname + fileExtension;
+    }
 
     // Important stuff
-    SDL_Window* window;
-    SDL_Renderer* renderer;
-    SDL_Texture* gameScreen = NULL;    
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    FrameRenderer frameRenderer;
 
     // Event stuff
     SDL_Event event;
     bool exit = false;
 
+    // Load the ROM once, up front. Every reset afterwards copies from the cached image.
+    // A bad path fails here, before SDL has been started at all.
+    const ROMImage* rom = LoadCH8ROM(path.c_str());
+    if (!rom) {
+        return 1;
+    }
+    if (!quirksGiven) {
+        machine.m_Quirks = ChooseQuirkProfile(DEFAULT_QUIRK_DATABASE, rom->hash);
+    }
+    if (!ROMFitsQuirkProfile(*rom, machine.m_Quirks)) {
+        return 1;
+    }
+
     // Ensure that SDL works
     if (initSDL(window, renderer)) {
 
-        // Reset the registers, keys, and memory
-        CPUReset();
+        // One texture for the whole run, at the CHIP-8's own resolution
+        if (!frameRenderer.Init(renderer, NATIVE_WIDTH, NATIVE_HEIGHT)) {
+            exit = true;
+        }
+        frameRenderer.scaleMode = scaleMode;
+        memcpy(frameRenderer.palette, palette, sizeof(palette));
 
-        // Start application loop
+        // Reset the registers, keys, and memory
+        machine.CPUReset(*rom);
+
+        // From here on the machine belongs to the emulation thread. This one just
+        // handles events and shows whatever frame was finished last.
+        // Row versions the texture currently holds. Nothing yet, so the first frame
+        // uploads everything.
+        uint32_t shownRowVersions[DISPLAY_MAX_HEIGHT];
+        memset(shownRowVersions, 0xFF, sizeof(shownRowVersions));
+        bool repaint = false;
+
+        EmulationThread emulator(machine, scheduler, inputQueue);
+        emulator.SetTurboSpeed(turboSpeed);
+        emulator.SetFrameSkip(frameSkip);
+
+        // Both are only touched once a frame when enabled, and not at all otherwise.
+        DebugServer debugServer;
+        StateExport stateExport;
+        if (debugPort > 0 && debugServer.Start(debugPort)) {
+            emulator.Debug(&debugServer);
+        }
+        if (!exportPath.empty() && stateExport.Open(exportPath.c_str())) {
+            emulator.Export(&stateExport);
+        }
+        MovieRecorder recorder;
+        if (!recordPath.empty()) {
+            recorder.Begin(machine, rom->hash, instructionsPerSecond);
+            emulator.Record(&recorder);
+        }
+        emulator.Start();
+
+        // The beeper follows the sound timer from SDL's audio thread. Opening the device
+        // can take a while, so it waits until the first frame is on screen. Running
+        // without sound is fine if there's no audio device.
+        AudioOutput audio;
+        bool audioOpened = false;
+
+        // The overlay's numbers are rates over the last half second.
+        const Uint32 OVERLAY_INTERVAL_MS = 500;
+        char overlayText[64] = "";
+        Uint32 overlayTicks = SDL_GetTicks();
+        uint64_t overlayInstructions = 0;
+        uint64_t overlayPresents = 0;
+        uint64_t presents = 0;
+        bool overlayShown = false;
         while (!exit) {
-
-            // Get opcode and load ROM file
-            WORD opcode = GetNextOpcode();
-            bool isLoaded = LoadCH8ROM(path.c_str());
-
-            // Once loaded, commence the opcode cycle!
-            if (isLoaded) {
-                DecodeOpcodeCycle(opcode);
-            }
-            else {
-                exit = true;
-            }
-
-            // SDL Input loop
             while (SDL_PollEvent(&event) != 0) {
                 if (event.type == SDL_QUIT) {
                     exit = true;
                 }
-                else if (event.type == SDL_KEYDOWN) {
-                    switch (event.key.keysym.sym) {
-                        case SDLK_0:
-                            m_Keyboard[0x0] = 1;
-                            break;
-                        case SDLK_1:
-                            m_Keyboard[0x1] = 1;
-                            break;
-                        case SDLK_2:
-                            m_Keyboard[0x2] = 1;
-                            break;
-                        case SDLK_3:
-                            m_Keyboard[0x3] = 1;
-                            break;
-                        case SDLK_4:
-                            m_Keyboard[0x4] = 1;
-                            break;
-                        case SDLK_5:
-                            m_Keyboard[0x5] = 1;
-                            break;
-                        case SDLK_6:
-                            m_Keyboard[0x6] = 1;
-                            break;
-                        case SDLK_7:
-                            m_Keyboard[0x7] = 1;
-                            break;
-                        case SDLK_8:
-                            m_Keyboard[0x8] = 1;
-                            break;
-                        case SDLK_9:
-                            m_Keyboard[0x9] = 1;
-                            break;
-                        case SDLK_a:
-                            m_Keyboard[0xA] = 1;
-                            break;
-                        case SDLK_b:
-                            m_Keyboard[0xB] = 1;
-                            break;
-                        case SDLK_c:
-                            m_Keyboard[0xC] = 1;
-                            break;
-				        case SDLK_d:
-                            m_Keyboard[0xD] = 1;
-                            break;
-                        case SDLK_e:
-                            m_Keyboard[0xE] = 1;
-                            break;
-                        case SDLK_f:
-                            m_Keyboard[0xF] = 1;
-                            break;
-                        default: 
-                            printf("no other actions after pressing any key\n");
-                            break;
-                    }
+                else if (event.type == SDL_WINDOWEVENT) {
+                    repaint = true;
                 }
-                else if (event.type == SDL_KEYUP) {
-                    switch (event.key.keysym.sym) {
-                        case SDLK_0:
-                            m_Keyboard[0x0] = 0;
-                            break;
-                        case SDLK_1:
-                            m_Keyboard[0x1] = 0;
-                            break;
-                        case SDLK_2:
-                            m_Keyboard[0x2] = 0;
-                            break;
-                        case SDLK_3:
-                            m_Keyboard[0x3] = 0;
-                            break;
-                        case SDLK_4:
-                            m_Keyboard[0x4] = 0;
-                            break;
-                        case SDLK_5:
-                            m_Keyboard[0x5] = 0;
-                            break;
-                        case SDLK_6:
-                            m_Keyboard[0x6] = 0;
-                            break;
-                        case SDLK_7:
-                            m_Keyboard[0x7] = 0;
-                            break;
-                        case SDLK_8:
-                            m_Keyboard[0x8] = 0;
-                            break;
-                        case SDLK_9:
-                            m_Keyboard[0x9] = 0;
-                            break;
-                        case SDLK_a:
-                            m_Keyboard[0xA] = 0;
-                            break;
-                        case SDLK_b:
-                            m_Keyboard[0xB] = 0;
-                            break; 
-                        case SDLK_c:
-                            m_Keyboard[0xC] = 0;
-                            break;
-                        case SDLK_d:
-                            m_Keyboard[0xD] = 0;
-                            break;
-                        case SDLK_e:
-                            m_Keyboard[0xE] = 0;
-                            break;
-                        case SDLK_f:
-                            m_Keyboard[0xF] = 0;
-                            break;
-                        default: 
-                            printf("no other actions after lifting from any key\n");
-                            break;
+                else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+                    bool pressed = event.type == SDL_KEYDOWN;
+                    int key = keyMap.Find(event.key.keysym.sym);
+                    if (key >= 0) {
+                        if (!inputQueue.Push({ (BYTE)key, (BYTE)pressed })) {
+                            LOG_WARN("Input queue full, dropped a key event");
+                        }
+                        emulator.Wake();
+                    }
+                    else if (pressed) {
+                        HandleHotkey(event.key.keysym.sym, emulator, showOverlay);
+                    }
+                    else {
+                        LOG_DEBUG("no other actions after lifting from any key");
                     }
                 }
             }
 
-            DrawPixels(renderer, gameScreen);
+            // Turning the overlay on or off, or new numbers on it, needs a repaint.
+            Uint32 ticks = SDL_GetTicks();
+            if (ticks - overlayTicks >= OVERLAY_INTERVAL_MS) {
+                uint64_t instructions = emulator.InstructionCount();
+                double seconds = (ticks - overlayTicks) / 1000.0;
+                snprintf(overlayText, sizeof(overlayText), "IPS %llu FPS %.0f X%d",
+                         (unsigned long long)((instructions - overlayInstructions) / seconds),
+                         (presents - overlayPresents) / seconds, emulator.Speed());
+                overlayTicks = ticks;
+                overlayInstructions = instructions;
+                overlayPresents = presents;
+                repaint |= showOverlay;
+            }
+            repaint |= showOverlay != overlayShown;
+            overlayShown = showOverlay;
+
+            // Only upload and present when the emulation finished a frame that changed
+            // something, or the window needs repainting.
+            bool present = false;
+            if (emulator.AcquireFrame()) {
+                present = DrawPixels(frameRenderer, emulator.Frame(), shownRowVersions);
+            }
+            if (!present && repaint) {
+                frameRenderer.Draw();
+                present = true;
+            }
+            repaint = false;
 
-            // Update window
-            SDL_RenderPresent(renderer);
+            if (present) {
+                if (showOverlay) {
+                    frameRenderer.DrawOverlay(overlayText);
+                }
+
+                // Update window
+                SDL_RenderPresent(renderer);
+                presents++;
+            }
+            else {
+                SDL_Delay(1);
+            }
+            if (!audioOpened && presents > 0) {
+                audio.Open(emulator.SoundGate());
+                audioOpened = true;
+            }
+        }
+        audio.Close();
+        emulator.Stop();
+
+        // The machine is ours again now that the emulation thread has stopped.
+        if (!recordPath.empty() && SaveMovie(recordPath, recorder.Finish(machine))) {
+            LOG_INFO("Saved a %llu frame movie to %s", (unsigned long long)recorder.GetMovie().frames, recordPath.c_str());
         }
     }
 
-    // Free surface and text texture 
-    SDL_DestroyTexture(gameScreen);
+    // Profile builds always leave their numbers behind
+    if (MachineProfiler::enabled) {
+        machine.DumpProfile(stdout);
+    }
+
+    // Free the game screen texture
+    frameRenderer.Destroy();
 
     // Close window and renderer
     SDL_DestroyRenderer(renderer);
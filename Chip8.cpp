@@ -0,0 +1,1180 @@
+﻿#include "Chip8.h"
+#include "ALU.h"
+#include "JIT.h"
+#include "Analyzer.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Font data
+const unsigned int numOfSprites = 16;
+const unsigned int numOfPixels = 5;
+constexpr BYTE m_FontData[numOfSprites][numOfPixels] = {
+    { 0xF0, 0x90, 0x90, 0x90, 0xF0 }, // 0
+    { 0x20, 0x60, 0x20, 0x20, 0x70 }, // 1
+    { 0xF0, 0x10, 0xF0, 0x80, 0xF0 }, // 2
+    { 0xF0, 0x10, 0xF0, 0x10, 0xF0 }, // 3
+    { 0x90, 0x90, 0xF0, 0x10, 0x10 }, // 4
+    { 0xF0, 0x80, 0xF0, 0x10, 0xF0 }, // 5
+    { 0xF0, 0x80, 0xF0, 0x90, 0xF0 }, // 6
+    { 0xF0, 0x10, 0x20, 0x40, 0x40 }, // 7
+    { 0xF0, 0x90, 0xF0, 0x90, 0xF0 }, // 8
+    { 0xF0, 0x90, 0xF0, 0x10, 0xF0 }, // 9
+    { 0xF0, 0x90, 0xF0, 0x90, 0x90 }, // A
+    { 0xE0, 0x90, 0xE0, 0x90, 0xE0 }, // B
+    { 0xF0, 0x80, 0x80, 0x80, 0xF0 }, // C
+    { 0xE0, 0x90, 0x90, 0x90, 0xE0 }, // D
+    { 0xF0, 0x80, 0xF0, 0x80, 0xF0 }, // E
+    { 0xF0, 0x80, 0xF0, 0x80, 0x80 }, // F
+};
+
+// SCHIP's 8x10 digits for FX30, plus XO-CHIP's A-F. They sit right after the small font.
+const unsigned int BIG_FONT_ADDRESS = numOfSprites * numOfPixels;
+const unsigned int bigFontPixels = 10;
+constexpr BYTE m_BigFontData[numOfSprites][bigFontPixels] = {
+    { 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF }, // 0
+    { 0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF }, // 1
+    { 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF }, // 2
+    { 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, // 3
+    { 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03 }, // 4
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, // 5
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF }, // 6
+    { 0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18 }, // 7
+    { 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF }, // 8
+    { 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, // 9
+    { 0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3 }, // A
+    { 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC }, // B
+    { 0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C }, // C
+    { 0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC }, // D
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF }, // E
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0 }, // F
+};
+
+static_assert(BIG_FONT_ADDRESS + sizeof(m_BigFontData) <= ROM_START_ADDRESS, "the fonts must fit below the ROM");
+
+// Everything below 0x200 the way a fresh machine sees it: both fonts, glyph after
+// glyph, then zeros. Built by the compiler, so putting it in place is one memcpy.
+static constexpr std::array<BYTE, ROM_START_ADDRESS> BuildBootImage() {
+    std::array<BYTE, ROM_START_ADDRESS> image = {};
+    for (unsigned int i = 0; i < numOfSprites; i++) {
+        for (unsigned int j = 0; j < numOfPixels; j++) {
+            image[i * numOfPixels + j] = m_FontData[i][j];
+        }
+        for (unsigned int j = 0; j < bigFontPixels; j++) {
+            image[BIG_FONT_ADDRESS + i * bigFontPixels + j] = m_BigFontData[i][j];
+        }
+    }
+    return image;
+}
+
+static constexpr std::array<BYTE, ROM_START_ADDRESS> BOOT_IMAGE = BuildBootImage();
+
+
+// Every ROM that gets loaded stays in here, shared by every machine in the process.
+static ROMCache m_ROMCache;
+
+const ROMImage* LoadCH8ROM(const char* fname) {
+    const ROMImage* rom = m_ROMCache.Load(fname);
+
+    // Analyze it while we're at it, so its CFG and pre-decoded code are ready to go.
+    if (rom) {
+        GetROMAnalysis(*rom);
+    }
+    return rom;
+}
+
+bool ROMFitsQuirkProfile(const ROMImage& rom, QuirkProfile quirks) {
+    if (rom.Size() > QuirkMemorySize(quirks) - ROM_START_ADDRESS) {
+        LOG_ERROR("ROM %s is too large for the %s profile. Please load another ROM file.", rom.path.c_str(), QuirkProfileName(quirks));
+        return false;
+    }
+    return true;
+}
+
+Chip8::Chip8() : m_DispatchMode(DefaultDispatchMode()) {
+    m_GameMemory.fill(0);
+    m_Registers.fill(0);
+    m_Keyboard.fill(0);
+    m_FlagRegisters.fill(0);
+    m_AudioPattern.fill(0);
+    m_PristineMemory.fill(0);
+    m_JITCodePages.fill(0);
+    m_Display.Clear();
+    m_SecondPlane.Clear();
+}
+
+// Out of line so JITCache is a complete type here.
+Chip8::~Chip8() {
+}
+
+// Lay out the fonts and the ROM the way a fresh machine would see them.
+void Chip8::BuildPristineMemory(const ROMImage& rom) {
+    memcpy(m_PristineMemory.data(), BOOT_IMAGE.data(), BOOT_IMAGE.size());
+
+    // Load the contents of ROM into addresses after 0x200, and clear whatever's past it
+    size_t romSize = std::min(rom.Size(), m_PristineMemory.size() - ROM_START_ADDRESS);
+    memcpy(&m_PristineMemory[ROM_START_ADDRESS], rom.Data(), romSize);
+    std::fill(m_PristineMemory.begin() + ROM_START_ADDRESS + romSize, m_PristineMemory.end(), 0);
+
+    m_PristineROM = &rom;
+}
+
+void Chip8::CPUReset(const ROMImage& rom) {
+
+    // Initialize address memory to 0
+    // Program Counter starts at address 0x200
+    m_AddressI = 0;
+    m_PC = 0x200;
+    m_Stack.fill(0);
+    m_SP = 0;
+    m_Fault = FAULT_NONE;
+    m_FaultPC = 0;
+    delayTimer = 0;
+    soundTimer = 0;
+    m_KeyWait = KEY_WAIT_NONE;
+    m_SkippedInstructions = 0;
+    m_Random.Seed(m_RandomSeed);
+
+    // Set registers and keyboard to 0
+    std::fill(std::begin(m_Registers), std::end(m_Registers), 0);
+    std::fill(std::begin(m_Keyboard), std::end(m_Keyboard), 0);
+
+    // Flags would survive on an HP-48, but every run starting from the same state
+    // matters more here.
+    m_FlagRegisters.fill(0);
+    m_AudioPattern.fill(0);
+    m_AudioPitch = 64;
+
+    // Back to 64x32 on the first plane
+    SetResolution(64, 32);
+    m_PlaneMask = 1;
+    m_Profiler.Reset();
+    m_UnknownOpcodes = 0;
+
+    // Game memory comes straight from the pristine image. Only the first reset
+    // with a new ROM has to build it.
+    if (m_PristineROM != &rom) {
+        BuildPristineMemory(rom);
+    }
+    m_GameMemory = m_PristineMemory;
+
+    // Any compiled code came from the old memory.
+    if (m_JIT) {
+        m_JIT->Flush();
+    }
+}
+
+bool Chip8::ResetToPristineROM() {
+    if (!m_PristineROM) {
+        return false;
+    }
+    CPUReset(*m_PristineROM);
+    return true;
+}
+
+static int GetRegisterX(WORD opcode) {
+    int regx = opcode & 0x0F00;
+    return regx >> 8;
+}
+
+static int GetRegisterY(WORD opcode) {
+    int regy = opcode & 0x00F0;
+    return regy >> 4;
+}
+
+// Pull the X, Y, N, NN and NNN fields out of an opcode. The kind is left unknown.
+static inline Instruction ExtractFields(WORD opcode) {
+    Instruction ins;
+    ins.kind = OP_Unknown;
+    ins.x = (BYTE)GetRegisterX(opcode);
+    ins.y = (BYTE)GetRegisterY(opcode);
+    ins.n = opcode & 0x000F;
+    ins.nn = opcode & 0x00FF;
+    ins.nnn = opcode & 0x0FFF;
+    return ins;
+}
+
+// Fetching the next set of opcode instructions
+WORD Chip8::GetNextOpcode() {
+    WORD res = 0;
+    res = m_GameMemory[m_PC];
+    res <<= 8;
+
+    // OR the bits from the next memory address to add them together.
+    res |= m_GameMemory[(WORD)(m_PC + 1)];
+
+    if (MachineProfiler::enabled) {
+        m_Profiler.Instruction(m_PC, GetDecodeTable()[res].kind);
+    }
+
+    // Increment twice b/c an opcode is 1 WORD long (2 bytes). Recall in the
+    // first few lines that variable res is making use of two memory addresses,
+    // which are 1 byte long. By increasing the PC with 2 bytes, this would fetch 
+    // the next instruction.
+    m_PC += 2;
+
+    return res;
+}
+
+// Anything that doesn't decode to a known opcode is skipped, and counted.
+template <class Quirks>
+void Chip8::OpcodeUnknown(const Instruction&) {
+    m_UnknownOpcodes++;
+}
+
+// Opcode 0NNN is for specific computers that uses some unique
+// machine code. It would pause a CHIP-8 program, then call a
+// machine language subroutine at NNN. Thus, it's best if this opcode is left
+// unimplemented because it would cause unexpected results at NNN.
+
+// Clear the screen
+template <class Quirks>
+void Chip8::Opcode00E0(const Instruction&) {
+    
+    // Set every pixel to 0.
+    ForEachSelectedPlane([](DisplayPlane& plane) { plane.Clear(); });
+    m_Profiler.Clear();
+}
+
+// Return from a subroutine
+template <class Quirks>
+void Chip8::Opcode00EE(const Instruction&) {
+    if (m_SP == 0) {
+        RaiseFault(FAULT_STACK_UNDERFLOW);
+        return;
+    }
+    m_PC = m_Stack[--m_SP];
+    m_Profiler.Return();
+}
+
+// Jump to address NNN
+template <class Quirks>
+void Chip8::Opcode1NNN(const Instruction& ins) {
+    m_PC = ins.nnn;
+}
+
+// Call subroutine at NNN
+template <class Quirks>
+void Chip8::Opcode2NNN(const Instruction& ins) {
+    if (m_SP == STACK_DEPTH) {
+        RaiseFault(FAULT_STACK_OVERFLOW);
+        return;
+    }
+    m_Stack[m_SP++] = m_PC;
+    m_PC = ins.nnn;
+    m_Profiler.Call(m_SP);
+}
+
+template <class Quirks>
+void Chip8::SkipNextInstruction() {
+    if (Quirks::longSkips && m_GameMemory[m_PC] == 0xF0 && m_GameMemory[(WORD)(m_PC + 1)] == 0x00) {
+        m_PC += 4;
+    }
+    else {
+        m_PC += 2;
+    }
+}
+
+// Skips next instruction if VX == NN
+template <class Quirks>
+void Chip8::Opcode3XNN(const Instruction& ins) {
+    int regx = ins.x;
+    int nn = ins.nn;
+    if (m_Registers[regx] == nn) {
+        SkipNextInstruction<Quirks>();
+    }
+}
+
+// Skips next instruction if VX != NN
+template <class Quirks>
+void Chip8::Opcode4XNN(const Instruction& ins) {
+    int regx = ins.x;
+    int nn = ins.nn;
+    if (m_Registers[regx] != nn) {
+        SkipNextInstruction<Quirks>();
+    }
+}
+
+// Skips next instruction if VX == VY
+template <class Quirks>
+void Chip8::Opcode5XY0(const Instruction& ins) {
+    if (m_Registers[ins.x] == m_Registers[ins.y]) {
+
+        // Skip to the next line of instruction.
+        SkipNextInstruction<Quirks>();
+    }
+}
+
+// Store number NN in register VX
+template <class Quirks>
+void Chip8::Opcode6XNN(const Instruction& ins) {
+    int regx = ins.x;
+    int nn = ins.nn;
+    m_Registers[regx] = nn;
+}
+
+// Add the value NN to register VX
+template <class Quirks>
+void Chip8::Opcode7XNN(const Instruction& ins) {
+    int nn = ins.nn;
+    m_Registers[ins.x] += nn;
+}
+
+// 8XY*: see ALU.h, shared with the lane interpreter
+template <class Quirks>
+void Chip8::Opcode8XY0(const Instruction& ins) {
+    Alu8XY0<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY1(const Instruction& ins) {
+    Alu8XY1<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY2(const Instruction& ins) {
+    Alu8XY2<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY3(const Instruction& ins) {
+    Alu8XY3<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY4(const Instruction& ins) {
+    Alu8XY4<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY5(const Instruction& ins) {
+    Alu8XY5<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY6(const Instruction& ins) {
+    Alu8XY6<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XY7(const Instruction& ins) {
+    Alu8XY7<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+template <class Quirks>
+void Chip8::Opcode8XYE(const Instruction& ins) {
+    Alu8XYE<Quirks>(m_Registers[ins.x], m_Registers[ins.y], m_Registers[0xF]);
+}
+
+// Skip the following instruction if the value of register VX is not equal to the value of register VY
+template <class Quirks>
+void Chip8::Opcode9XY0(const Instruction& ins) {
+    if (m_Registers[ins.x] != m_Registers[ins.y]) {
+        SkipNextInstruction<Quirks>();
+    }
+}
+
+// Store memory address NNN in register I
+template <class Quirks>
+void Chip8::OpcodeANNN(const Instruction& ins) {
+    int nnn = ins.nnn;
+    m_AddressI = nnn;
+}
+
+// Jump to address NNN + V0
+// Quirk: CHIP-48 and SCHIP read it as BXNN and jump to XNN + VX
+template <class Quirks>
+void Chip8::OpcodeBNNN(const Instruction& ins) {
+    int nnn = ins.nnn;
+    m_PC = nnn + m_Registers[Quirks::jumpUsesVX ? ins.x : 0x0];
+}
+
+// Set VX to a random number with a mask of NN
+template <class Quirks>
+void Chip8::OpcodeCXNN(const Instruction& ins) {
+    int nn = ins.nn;
+    m_Registers[ins.x] = (BYTE)(m_Random.Next() >> 24) & nn;
+}
+
+// Draw sprite at coord (VX, VY) with width of 8 pixels and N bytes.
+// Set VF to 01 if any set pixels are changed to unset, and 00 otherwise
+template <class Quirks>
+void Chip8::OpcodeDXYN(const Instruction& ins) {
+
+    // Get the height of an arbitrary sprite
+    // No need to set a width because all sprites
+    // are 8 pixels wide.
+    DrawOnPlanes<Quirks>(ins, ins.n, false);
+}
+
+// SCHIP: draw a 16x16 sprite, two bytes per row
+template <class Quirks>
+void Chip8::OpcodeDXY0(const Instruction& ins) {
+    DrawOnPlanes<Quirks>(ins, 16, true);
+}
+
+template <class Quirks>
+void Chip8::DrawOnPlanes(const Instruction& ins, int rows, bool wide) {
+
+    // Coords start at top left of the screen
+    // These will the locations of the sprite drawn on
+    // screen
+    int coordx = m_Registers[ins.x];
+    int coordy = m_Registers[ins.y];
+
+    // Game memory stores sprite data here. Each byte is one line of the sprite,
+    // with pixel 0 in bit 7, pixel 1 in bit 6... pixel 7 in bit 0. With both XO-CHIP
+    // planes selected, the second plane's sprite follows right after the first's.
+    const int length = wide ? rows * 2 : rows;
+    int address = m_AddressI;
+    bool collision = false;
+    ForEachSelectedPlane([&](DisplayPlane& plane) {
+        BYTE sprite[32];
+        for (int i = 0; i < length; i++) {
+            sprite[i] = m_GameMemory[(address + i) & Quirks::memoryMask];
+        }
+        address += length;
+
+        // Every line gets shifted into place and XORed onto the display. If any
+        // lit pixel got turned off along the way, that's a collision.
+        collision |= plane.DrawSprite(sprite, coordx, coordy, rows, Quirks::wrapSprites, wide);
+    });
+    m_Registers[0xF] = collision ? 1 : 0;
+    m_Profiler.Draw();
+}
+
+// Whether the key EX9E/EXA1 ask about is down
+// Quirk: legacy compares VX with the state of key X rather than looking key VX up
+template <class Quirks>
+bool Chip8::IsKeyInVXDown(const Instruction& ins) const {
+    if (Quirks::legacyKeyTest) {
+        return m_Registers[ins.x] == m_Keyboard[ins.x];
+    }
+    return m_Keyboard[m_Registers[ins.x] & 0xF] != 0;
+}
+
+// Skips next instruction if key in VX is pressed
+template <class Quirks>
+void Chip8::OpcodeEX9E(const Instruction& ins) {
+    if (IsKeyInVXDown<Quirks>(ins)) {
+        SkipNextInstruction<Quirks>();
+    }
+}
+
+// Skips next instruction if key in VX is not pressed
+template <class Quirks>
+void Chip8::OpcodeEXA1(const Instruction& ins) {
+    if (!IsKeyInVXDown<Quirks>(ins)) {
+        SkipNextInstruction<Quirks>();
+    }
+}
+
+// Store the current value of the delay timer in register VX
+template <class Quirks>
+void Chip8::OpcodeFX07(const Instruction& ins) {
+    m_Registers[ins.x] = delayTimer;
+}
+
+// Set the delay timer to the value of register VX
+template <class Quirks>
+void Chip8::OpcodeFX15(const Instruction& ins) {
+    delayTimer = m_Registers[ins.x];
+}
+
+// Set the sound timer to the value of register VX
+template <class Quirks>
+void Chip8::OpcodeFX18(const Instruction& ins) {
+    soundTimer = m_Registers[ins.x];
+}
+
+// Add the value stored in register VX to register I
+template <class Quirks>
+void Chip8::OpcodeFX1E(const Instruction& ins) {
+    m_AddressI += m_Registers[ins.x];
+}
+
+// Wait for a key to be pressed and released, and store it in register VX
+// Until then the PC is put back on this instruction so it runs again, the way the
+// VIP sat in its own wait loop. The timers keep counting down meanwhile.
+template <class Quirks>
+void Chip8::OpcodeFX0A(const Instruction& ins) {
+    if (m_KeyWait == KEY_WAIT_NONE) {
+        m_KeyWait = KEY_WAIT_ANY;
+    }
+
+    if (m_KeyWait == KEY_WAIT_ANY) {
+        for (int i = 0; i < (int)sizeof(m_Keyboard); i++) {
+            if (m_Keyboard[i] != 0) {
+                m_KeyWait = (BYTE)i;
+                break;
+            }
+        }
+    }
+    else if (m_Keyboard[m_KeyWait] == 0) {
+        m_Registers[ins.x] = m_KeyWait;
+        m_KeyWait = KEY_WAIT_NONE;
+        return;
+    }
+
+    m_PC -= 2;
+}
+
+// Set register I to the memory address of the sprite data corresponding to 
+// the hexadecimal digit stored in register VX
+template <class Quirks>
+void Chip8::OpcodeFX29(const Instruction& ins) {
+    int regx = m_Registers[ins.x] & 0xF;
+
+    // Glyphs are packed numOfPixels bytes apart in the boot image.
+    m_AddressI = regx * numOfPixels;
+}
+
+// Store Binary-coded decimal in register VX
+template <class Quirks>
+void Chip8::OpcodeFX33(const Instruction& ins) {
+    int value = m_Registers[ins.x];
+
+    int hundreds = value / 100;
+    int tens = (value / 10) % 10;
+    int units = value % 10;
+
+    m_GameMemory[m_AddressI & Quirks::memoryMask] = hundreds;
+    m_GameMemory[(m_AddressI + 1) & Quirks::memoryMask] = tens;
+    m_GameMemory[(m_AddressI + 2) & Quirks::memoryMask] = units;
+    NoteStoreAtI<Quirks>(3);
+}
+
+// Where FX55 and FX65 leave I once they're done with V0 to VX
+template <class Quirks>
+static inline WORD NextAddressI(WORD addressI, int x) {
+    switch (Quirks::loadStore) {
+        case LOAD_STORE_I_PLUS_X_PLUS_1: return (WORD)(addressI + x + 1);
+        case LOAD_STORE_I_PLUS_X: return (WORD)(addressI + x);
+        case LOAD_STORE_I_UNCHANGED: return addressI;
+    }
+    return addressI;
+}
+
+// Stores V0 to VX in memory starting at address I
+template <class Quirks>
+void Chip8::OpcodeFX55(const Instruction& ins) {
+    int regx = ins.x;
+    for (int i = 0; i <= regx; i++) {
+        m_GameMemory[(m_AddressI + i) & Quirks::memoryMask] = m_Registers[i];
+    }
+    NoteStoreAtI<Quirks>(regx + 1);
+    m_AddressI = NextAddressI<Quirks>(m_AddressI, regx);
+}
+
+// Fills V0 to VX with values from memory starting at address I
+template <class Quirks>
+void Chip8::OpcodeFX65(const Instruction& ins) {
+    int xval = ins.x;
+    for (int i = 0; i <= xval; i++) {
+        m_Registers[i] = m_GameMemory[(m_AddressI + i) & Quirks::memoryMask];
+    }
+    m_AddressI = NextAddressI<Quirks>(m_AddressI, xval);
+}
+
+// SCHIP: scroll the screen down N pixels
+template <class Quirks>
+void Chip8::Opcode00CN(const Instruction& ins) {
+    const int rows = ins.n;
+    ForEachSelectedPlane([rows](DisplayPlane& plane) { plane.ScrollDown(rows); });
+}
+
+// XO-CHIP: scroll the screen up N pixels
+template <class Quirks>
+void Chip8::Opcode00DN(const Instruction& ins) {
+    const int rows = ins.n;
+    ForEachSelectedPlane([rows](DisplayPlane& plane) { plane.ScrollUp(rows); });
+}
+
+// SCHIP: scroll the screen right 4 pixels
+template <class Quirks>
+void Chip8::Opcode00FB(const Instruction&) {
+    ForEachSelectedPlane([](DisplayPlane& plane) { plane.ScrollRight(); });
+}
+
+// SCHIP: scroll the screen left 4 pixels
+template <class Quirks>
+void Chip8::Opcode00FC(const Instruction&) {
+    ForEachSelectedPlane([](DisplayPlane& plane) { plane.ScrollLeft(); });
+}
+
+// SCHIP: exit the interpreter. The machine parks here like it would on a fault.
+template <class Quirks>
+void Chip8::Opcode00FD(const Instruction&) {
+    RaiseFault(FAULT_EXIT);
+}
+
+// SCHIP: back to the regular 64x32 screen
+template <class Quirks>
+void Chip8::Opcode00FE(const Instruction&) {
+    SetResolution(64, 32);
+}
+
+// SCHIP: switch to the 128x64 screen
+template <class Quirks>
+void Chip8::Opcode00FF(const Instruction&) {
+    SetResolution(DISPLAY_MAX_WIDTH, DISPLAY_MAX_HEIGHT);
+}
+
+// XO-CHIP: store VX to VY (in either order) in memory starting at I. I is unchanged.
+template <class Quirks>
+void Chip8::Opcode5XY2(const Instruction& ins) {
+    int step = ins.x <= ins.y ? 1 : -1;
+    int count = (ins.x <= ins.y ? ins.y - ins.x : ins.x - ins.y) + 1;
+    for (int i = 0; i < count; i++) {
+        m_GameMemory[(m_AddressI + i) & Quirks::memoryMask] = m_Registers[ins.x + i * step];
+    }
+    NoteStoreAtI<Quirks>(count);
+}
+
+// XO-CHIP: load VX to VY (in either order) from memory starting at I. I is unchanged.
+template <class Quirks>
+void Chip8::Opcode5XY3(const Instruction& ins) {
+    int step = ins.x <= ins.y ? 1 : -1;
+    int count = (ins.x <= ins.y ? ins.y - ins.x : ins.x - ins.y) + 1;
+    for (int i = 0; i < count; i++) {
+        m_Registers[ins.x + i * step] = m_GameMemory[(m_AddressI + i) & Quirks::memoryMask];
+    }
+}
+
+// XO-CHIP: load the 16 bit address in the next two bytes into I
+template <class Quirks>
+void Chip8::OpcodeF000(const Instruction&) {
+    m_AddressI = (WORD)((m_GameMemory[m_PC] << 8) | m_GameMemory[(WORD)(m_PC + 1)]);
+    m_PC += 2;
+}
+
+// XO-CHIP: select the planes (bit 0 the first, bit 1 the second) that drawing,
+// clearing and scrolling work on
+template <class Quirks>
+void Chip8::OpcodeFN01(const Instruction& ins) {
+    m_PlaneMask = ins.x & 3;
+}
+
+// XO-CHIP: load the 16 byte audio pattern from I
+template <class Quirks>
+void Chip8::OpcodeF002(const Instruction&) {
+    for (int i = 0; i < (int)m_AudioPattern.size(); i++) {
+        m_AudioPattern[i] = m_GameMemory[(m_AddressI + i) & Quirks::memoryMask];
+    }
+}
+
+// SCHIP: point I at the big font glyph for the digit in VX
+template <class Quirks>
+void Chip8::OpcodeFX30(const Instruction& ins) {
+    m_AddressI = BIG_FONT_ADDRESS + (m_Registers[ins.x] & 0xF) * bigFontPixels;
+}
+
+// XO-CHIP: set the audio pattern's playback pitch to VX
+template <class Quirks>
+void Chip8::OpcodeFX3A(const Instruction& ins) {
+    m_AudioPitch = m_Registers[ins.x];
+}
+
+// SCHIP: save V0 to VX in the user flags
+template <class Quirks>
+void Chip8::OpcodeFX75(const Instruction& ins) {
+    for (int i = 0; i <= ins.x; i++) {
+        m_FlagRegisters[i] = m_Registers[i];
+    }
+}
+
+// SCHIP: load V0 to VX from the user flags
+template <class Quirks>
+void Chip8::OpcodeFX85(const Instruction& ins) {
+    for (int i = 0; i <= ins.x; i++) {
+        m_Registers[i] = m_FlagRegisters[i];
+    }
+}
+
+// Starts the opcode decoding cycle
+void Chip8::DecodeOpcodeCycle(WORD opcode) {
+    switch (m_Quirks) {
+#define CHIP8_QUIRK_CASE(id, policy, name) case QUIRKS_##id: DecodeSwitch<policy>(opcode); break;
+        CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_CASE)
+#undef CHIP8_QUIRK_CASE
+        default: break;
+    }
+}
+
+template <class Quirks>
+void Chip8::DecodeSwitch(WORD opcode) {
+    const Instruction ins = ExtractFields(opcode);
+
+    switch (opcode & 0xF000) {
+        case 0x0000: {
+
+            // The SCHIP and XO-CHIP screen ops first; everything else goes by the low nibble, as it always has.
+            switch (opcode & 0x0FF0) {
+                case 0x00C0: Opcode00CN<Quirks>(ins); break;
+                case 0x00D0: Opcode00DN<Quirks>(ins); break;
+                default:
+                    switch (opcode & 0x0FFF) {
+                        case 0x00FB: Opcode00FB<Quirks>(ins); break;
+                        case 0x00FC: Opcode00FC<Quirks>(ins); break;
+                        case 0x00FD: Opcode00FD<Quirks>(ins); break;
+                        case 0x00FE: Opcode00FE<Quirks>(ins); break;
+                        case 0x00FF: Opcode00FF<Quirks>(ins); break;
+                        default:
+                            switch (opcode & 0x000F) {
+                                case 0x0000: Opcode00E0<Quirks>(ins); break;
+                                case 0x000E: Opcode00EE<Quirks>(ins); break;
+                                default: OpcodeUnknown<Quirks>(ins); break;
+                            }
+                            break;
+                    }
+                    break;
+            }
+        } break;
+        case 0x1000: Opcode1NNN<Quirks>(ins); break;
+        case 0x2000: Opcode2NNN<Quirks>(ins); break;
+        case 0x3000: Opcode3XNN<Quirks>(ins); break;
+        case 0x4000: Opcode4XNN<Quirks>(ins); break;
+        case 0x5000: {
+            switch (opcode & 0x000F) {
+                case 0x0002: Opcode5XY2<Quirks>(ins); break;
+                case 0x0003: Opcode5XY3<Quirks>(ins); break;
+                default: Opcode5XY0<Quirks>(ins); break;
+            }
+        } break;
+        case 0x6000: Opcode6XNN<Quirks>(ins); break;
+        case 0x7000: Opcode7XNN<Quirks>(ins); break;
+        case 0x8000: {
+            switch (opcode & 0x000F) {
+                case 0x0000: Opcode8XY0<Quirks>(ins); break;
+                case 0x0001: Opcode8XY1<Quirks>(ins); break;
+                case 0x0002: Opcode8XY2<Quirks>(ins); break;
+                case 0x0003: Opcode8XY3<Quirks>(ins); break;
+                case 0x0004: Opcode8XY4<Quirks>(ins); break;
+                case 0x0005: Opcode8XY5<Quirks>(ins); break;
+                case 0x0006: Opcode8XY6<Quirks>(ins); break;
+                case 0x0007: Opcode8XY7<Quirks>(ins); break;
+                case 0x000E: Opcode8XYE<Quirks>(ins); break;
+                default: OpcodeUnknown<Quirks>(ins); break;
+            }
+        } break;
+        case 0x9000: Opcode9XY0<Quirks>(ins); break;
+        case 0xA000: OpcodeANNN<Quirks>(ins); break;
+        case 0xB000: OpcodeBNNN<Quirks>(ins); break;
+        case 0xC000: OpcodeCXNN<Quirks>(ins); break;
+        case 0xD000: {
+            if (opcode & 0x000F) {
+                OpcodeDXYN<Quirks>(ins);
+            }
+            else {
+                OpcodeDXY0<Quirks>(ins);
+            }
+        } break;
+        case 0xE000: {
+            switch (opcode & 0x00FF) {
+                case 0x009E: OpcodeEX9E<Quirks>(ins); break;
+                case 0x00A1: OpcodeEXA1<Quirks>(ins); break;
+                default: OpcodeUnknown<Quirks>(ins); break;
+            }
+        } break;
+        case 0xF000: {
+            switch (opcode & 0x00FF) {
+                case 0x0000: if (opcode == 0xF000) { OpcodeF000<Quirks>(ins); } else { OpcodeUnknown<Quirks>(ins); } break;
+                case 0x0001: OpcodeFN01<Quirks>(ins); break;
+                case 0x0002: if (opcode == 0xF002) { OpcodeF002<Quirks>(ins); } else { OpcodeUnknown<Quirks>(ins); } break;
+                case 0x0007: OpcodeFX07<Quirks>(ins); break;
+                case 0x000A: OpcodeFX0A<Quirks>(ins); break;
+                case 0x0015: OpcodeFX15<Quirks>(ins); break;
+                case 0x0018: OpcodeFX18<Quirks>(ins); break;
+                case 0x001E: OpcodeFX1E<Quirks>(ins); break;
+                case 0x0029: OpcodeFX29<Quirks>(ins); break;
+                case 0x0030: OpcodeFX30<Quirks>(ins); break;
+                case 0x0033: OpcodeFX33<Quirks>(ins); break;
+                case 0x003A: OpcodeFX3A<Quirks>(ins); break;
+                case 0x0055: OpcodeFX55<Quirks>(ins); break;
+                case 0x0065: OpcodeFX65<Quirks>(ins); break;
+                case 0x0075: OpcodeFX75<Quirks>(ins); break;
+                case 0x0085: OpcodeFX85<Quirks>(ins); break;
+                default: OpcodeUnknown<Quirks>(ins); break;
+            }
+        } break;
+        default: 
+            LOG_DEBUG("Unknown opcode %04X at %03X", opcode, m_PC - 2);
+            break;
+    };
+
+}
+
+// Work out which handler an opcode belongs to. This follows the exact same
+// rules as the switch in DecodeOpcodeCycle so every dispatch mode agrees.
+Instruction DecodeInstruction(WORD opcode) {
+    Instruction ins = ExtractFields(opcode);
+
+    switch (opcode & 0xF000) {
+        case 0x0000: {
+
+            // The SCHIP and XO-CHIP screen ops first; everything else goes by the low nibble, as it always has.
+            switch (opcode & 0x0FF0) {
+                case 0x00C0: ins.kind = OP_00CN; break;
+                case 0x00D0: ins.kind = OP_00DN; break;
+                default:
+                    switch (opcode & 0x0FFF) {
+                        case 0x00FB: ins.kind = OP_00FB; break;
+                        case 0x00FC: ins.kind = OP_00FC; break;
+                        case 0x00FD: ins.kind = OP_00FD; break;
+                        case 0x00FE: ins.kind = OP_00FE; break;
+                        case 0x00FF: ins.kind = OP_00FF; break;
+                        default:
+                            switch (opcode & 0x000F) {
+                                case 0x0000: ins.kind = OP_00E0; break;
+                                case 0x000E: ins.kind = OP_00EE; break;
+                            }
+                            break;
+                    }
+                    break;
+            }
+        } break;
+        case 0x1000: ins.kind = OP_1NNN; break;
+        case 0x2000: ins.kind = OP_2NNN; break;
+        case 0x3000: ins.kind = OP_3XNN; break;
+        case 0x4000: ins.kind = OP_4XNN; break;
+        case 0x5000: {
+            switch (opcode & 0x000F) {
+                case 0x0002: ins.kind = OP_5XY2; break;
+                case 0x0003: ins.kind = OP_5XY3; break;
+                default: ins.kind = OP_5XY0; break;
+            }
+        } break;
+        case 0x6000: ins.kind = OP_6XNN; break;
+        case 0x7000: ins.kind = OP_7XNN; break;
+        case 0x8000: {
+            switch (opcode & 0x000F) {
+                case 0x0000: ins.kind = OP_8XY0; break;
+                case 0x0001: ins.kind = OP_8XY1; break;
+                case 0x0002: ins.kind = OP_8XY2; break;
+                case 0x0003: ins.kind = OP_8XY3; break;
+                case 0x0004: ins.kind = OP_8XY4; break;
+                case 0x0005: ins.kind = OP_8XY5; break;
+                case 0x0006: ins.kind = OP_8XY6; break;
+                case 0x0007: ins.kind = OP_8XY7; break;
+                case 0x000E: ins.kind = OP_8XYE; break;
+            }
+        } break;
+        case 0x9000: ins.kind = OP_9XY0; break;
+        case 0xA000: ins.kind = OP_ANNN; break;
+        case 0xB000: ins.kind = OP_BNNN; break;
+        case 0xC000: ins.kind = OP_CXNN; break;
+        case 0xD000: {
+            if (opcode & 0x000F) {
+                ins.kind = OP_DXYN;
+            }
+            else {
+                ins.kind = OP_DXY0;
+            }
+        } break;
+        case 0xE000: {
+            switch (opcode & 0x00FF) {
+                case 0x009E: ins.kind = OP_EX9E; break;
+                case 0x00A1: ins.kind = OP_EXA1; break;
+            }
+        } break;
+        case 0xF000: {
+            switch (opcode & 0x00FF) {
+                case 0x0000: if (opcode == 0xF000) { ins.kind = OP_F000; } break;
+                case 0x0001: ins.kind = OP_FN01; break;
+                case 0x0002: if (opcode == 0xF002) { ins.kind = OP_F002; } break;
+                case 0x0007: ins.kind = OP_FX07; break;
+                case 0x000A: ins.kind = OP_FX0A; break;
+                case 0x0015: ins.kind = OP_FX15; break;
+                case 0x0018: ins.kind = OP_FX18; break;
+                case 0x001E: ins.kind = OP_FX1E; break;
+                case 0x0029: ins.kind = OP_FX29; break;
+                case 0x0030: ins.kind = OP_FX30; break;
+                case 0x0033: ins.kind = OP_FX33; break;
+                case 0x003A: ins.kind = OP_FX3A; break;
+                case 0x0055: ins.kind = OP_FX55; break;
+                case 0x0065: ins.kind = OP_FX65; break;
+                case 0x0075: ins.kind = OP_FX75; break;
+                case 0x0085: ins.kind = OP_FX85; break;
+            }
+        } break;
+    }
+
+    return ins;
+}
+
+// Lets a member handler sit in a plain function pointer table.
+template <void (Chip8::*Handler)(const Instruction&)>
+static void CallHandler(Chip8& machine, const Instruction& ins) {
+    (machine.*Handler)(ins);
+}
+
+// One handler table per quirk profile
+template <class Quirks>
+static const Chip8::OpcodeHandler s_HandlerTable[OP_COUNT] = {
+#define CHIP8_HANDLER_ENTRY(name) &CallHandler<&Chip8::Opcode##name<Quirks>>,
+    CHIP8_OPCODES(CHIP8_HANDLER_ENTRY)
+#undef CHIP8_HANDLER_ENTRY
+};
+
+const Chip8::OpcodeHandler* const Chip8::s_OpcodeHandlers[QUIRK_PROFILE_COUNT] = {
+#define CHIP8_QUIRK_TABLE(id, policy, name) s_HandlerTable<policy>,
+    CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_TABLE)
+#undef CHIP8_QUIRK_TABLE
+};
+
+// 64K entries * 8 bytes = 512 KB, built the first time any machine needs it.
+// Function-local statics are initialized exactly once even with many threads racing.
+const Instruction* GetDecodeTable() {
+    static const std::vector<Instruction> decodeTable = [] {
+        std::vector<Instruction> table(0x10000);
+        for (int opcode = 0; opcode < 0x10000; opcode++) {
+            table[opcode] = DecodeInstruction((WORD)opcode);
+        }
+        return table;
+    }();
+    return decodeTable.data();
+}
+
+bool IsThreadedDispatchAvailable() {
+#if defined(__GNUC__) || defined(__clang__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* MachineFaultName(MachineFault fault) {
+    switch (fault) {
+        case FAULT_NONE: return "none";
+        case FAULT_STACK_OVERFLOW: return "stack overflow";
+        case FAULT_STACK_UNDERFLOW: return "stack underflow";
+        case FAULT_EXIT: return "exited";
+    }
+    return "unknown";
+}
+
+DispatchMode DefaultDispatchMode() {
+    return IsThreadedDispatchAvailable() ? DISPATCH_THREADED : DISPATCH_TABLE;
+}
+
+const char* DispatchModeName(DispatchMode mode) {
+    switch (mode) {
+        case DISPATCH_SWITCH: return "switch";
+        case DISPATCH_TABLE: return "table";
+        case DISPATCH_THREADED: return "threaded";
+        case DISPATCH_JIT: return "jit";
+    }
+    return "unknown";
+}
+
+bool ParseDispatchMode(const char* name, DispatchMode& mode) {
+    for (int i = DISPATCH_SWITCH; i <= DISPATCH_JIT; i++) {
+        if (strcmp(name, DispatchModeName((DispatchMode)i)) == 0) {
+            mode = (DispatchMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class Quirks>
+void Chip8::RunSwitch(int count) {
+    for (int i = 0; i < count; i++) {
+        DecodeSwitch<Quirks>(GetNextOpcode());
+    }
+}
+
+void Chip8::RunTable(int count) {
+    const Instruction* table = GetDecodeTable();
+    const OpcodeHandler* handlers = Handlers();
+    for (int i = 0; i < count; i++) {
+        const Instruction& ins = table[GetNextOpcode()];
+        handlers[ins.kind](*this, ins);
+    }
+}
+
+// Threaded interpreter: every handler body ends by fetching the next instruction and
+// jumping straight to its label, so there's no central dispatch branch to mispredict.
+template <class Quirks>
+void Chip8::RunThreaded(int count) {
+#if defined(__GNUC__) || defined(__clang__)
+    static void* const labels[OP_COUNT] = {
+#define CHIP8_LABEL_ENTRY(name) &&op_##name,
+        CHIP8_OPCODES(CHIP8_LABEL_ENTRY)
+#undef CHIP8_LABEL_ENTRY
+    };
+
+    if (count <= 0) {
+        return;
+    }
+
+    const Instruction* table = GetDecodeTable();
+    const Instruction* ins = &table[GetNextOpcode()];
+    goto *labels[ins->kind];
+
+#define CHIP8_THREADED_BODY(name) \
+    op_##name: \
+        Opcode##name<Quirks>(*ins); \
+        if (--count == 0) { \
+            return; \
+        } \
+        ins = &table[GetNextOpcode()]; \
+        goto *labels[ins->kind];
+    CHIP8_OPCODES(CHIP8_THREADED_BODY)
+#undef CHIP8_THREADED_BODY
+#else
+    RunTable(count);
+#endif
+}
+
+// The longest idle loop looked for. Anything longer is doing real work more often than not.
+static const int MAX_IDLE_LOOP_LENGTH = 8;
+
+// What an idle loop may contain: nothing that touches memory, the screen, the stack, I,
+// the timers or the random numbers, so a round only depends on the registers, the delay
+// timer and the keys.
+static bool IsIdleLoopOpcode(BYTE kind) {
+    switch (kind) {
+        case OP_1NNN: case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0:
+        case OP_6XNN: case OP_7XNN:
+        case OP_8XY0: case OP_8XY1: case OP_8XY2: case OP_8XY3: case OP_8XY4:
+        case OP_8XY5: case OP_8XY6: case OP_8XY7: case OP_8XYE:
+        case OP_EX9E: case OP_EXA1: case OP_FX07: case OP_FX0A:
+            return true;
+    }
+    return false;
+}
+
+int Chip8::RunIdleRound(int limit, int& ran) {
+    const WORD head = m_PC;
+    const Instruction* table = GetDecodeTable();
+    for (int length = 1; length <= limit; length++) {
+        WORD opcode = (WORD)((m_GameMemory[m_PC] << 8) | m_GameMemory[(WORD)(m_PC + 1)]);
+        if (!IsIdleLoopOpcode(table[opcode].kind)) {
+            return 0;
+        }
+        DecodeOpcodeCycle(GetNextOpcode());
+        ran++;
+        if (m_PC == head) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+int Chip8::SkipIdleLoop(int count) {
+    int ran = 0;
+
+    // One round to get whatever registers the loop writes into their steady state, and
+    // a second to check they stay there. If they do, every round after is that same
+    // round again, until a timer tick or a key change this call can't see.
+    int length = RunIdleRound(std::min(count, MAX_IDLE_LOOP_LENGTH), ran);
+    if (length == 0) {
+        return ran;
+    }
+    const std::array<BYTE, 16> registers = m_Registers;
+    const BYTE keyWait = m_KeyWait;
+    if (RunIdleRound(std::min(count - ran, length), ran) != length || m_Registers != registers || m_KeyWait != keyWait) {
+        return ran;
+    }
+
+    int rounds = (count - ran) / length;
+    m_SkippedInstructions += (uint64_t)rounds * length;
+    return ran + rounds * length;
+}
+
+int Chip8::RunInstructions(int count) {
+
+    // A faulted machine doesn't run any more.
+    if (m_Fault != FAULT_NONE) {
+        return 0;
+    }
+    const int requested = count;
+    m_FaultRetries = 0;
+
+    if (m_SkipIdleLoops) {
+        count -= SkipIdleLoop(count);
+    }
+
+    switch (m_DispatchMode) {
+        case DISPATCH_SWITCH:
+            switch (m_Quirks) {
+#define CHIP8_QUIRK_CASE(id, policy, name) case QUIRKS_##id: RunSwitch<policy>(count); break;
+                CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_CASE)
+#undef CHIP8_QUIRK_CASE
+                default: break;
+            }
+            break;
+        case DISPATCH_TABLE:
+            RunTable(count);
+            break;
+        case DISPATCH_THREADED:
+            switch (m_Quirks) {
+#define CHIP8_QUIRK_CASE(id, policy, name) case QUIRKS_##id: RunThreaded<policy>(count); break;
+                CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_CASE)
+#undef CHIP8_QUIRK_CASE
+                default: break;
+            }
+            break;
+        case DISPATCH_JIT:
+            if (!m_JIT) {
+                m_JIT.reset(new JITCache(*this));
+            }
+            m_JIT->Run(count);
+            break;
+    }
+
+    // Whatever was left of the batch after a fault just kept hitting it.
+    return std::max(requested, 0) - m_FaultRetries;
+}
+
+void Chip8::TickTimers() {
+
+    // If delay timer is bigger than 0, decrement
+    if (delayTimer > 0) {
+        delayTimer--;
+    }
+
+    // Same as delay timer, but if it is above 0, play a beeping sound
+    if (soundTimer > 0) {
+        LOG_TRACE("Beeping sound");
+        soundTimer--;
+    }
+}
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+uint64_t Chip8::HashDisplay() const {
+    uint64_t hash = HashBytes(0xCBF29CE484222325ull, m_Display.words, m_Display.WordCount() * sizeof(uint64_t));
+    return HashBytes(hash, m_SecondPlane.words, m_SecondPlane.WordCount() * sizeof(uint64_t));
+}
+
+uint64_t Chip8::HashState() const {
+    uint64_t hash = HashDisplay();
+    hash = HashBytes(hash, m_GameMemory.data(), m_GameMemory.size());
+    hash = HashBytes(hash, m_Registers.data(), m_Registers.size());
+    hash = HashBytes(hash, &m_AddressI, sizeof(m_AddressI));
+    hash = HashBytes(hash, &m_PC, sizeof(m_PC));
+    hash = HashBytes(hash, m_Stack.data(), m_SP * sizeof(WORD));
+    hash = HashBytes(hash, &m_SP, sizeof(m_SP));
+    hash = HashBytes(hash, &delayTimer, sizeof(delayTimer));
+    hash = HashBytes(hash, &soundTimer, sizeof(soundTimer));
+    hash = HashBytes(hash, &m_KeyWait, sizeof(m_KeyWait));
+    hash = HashBytes(hash, &m_Random.state, sizeof(m_Random.state));
+    return hash;
+}
+
+void Chip8::InvalidateCode(int address, int length) {
+    if (m_JIT) {
+        m_JIT->Invalidate(address, length);
+    }
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+// CHIP-8 core
+// One Chip8 object is one complete machine: memory, registers, timers, display, and the
+// dispatch engines that drive its opcode handlers. Nothing lives at file scope, so any
+// number of machines can run side by side, each on its own thread.
+// Documentations utilized:
+// - https://en.wikipedia.org/wiki/CHIP-8#Opcode_table
+// - https://github.com/mattmikolay/chip-8/wiki/CHIP%E2%80%908-Technical-Reference
+
+#include "Types.h"
+#include "ROM.h"
+#include "Display.h"
+#include "Profile.h"
+#include "Quirks.h"
+#include "Random.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Every opcode the core knows about: CHIP-8, then the SUPER-CHIP additions, then
+// XO-CHIP's. Unknown covers anything that doesn't decode, which the interpreter simply
+// skips over.
+#define CHIP8_OPCODES(X) \
+    X(Unknown) \
+    X(00E0) X(00EE) X(1NNN) X(2NNN) X(3XNN) X(4XNN) X(5XY0) X(6XNN) X(7XNN) \
+    X(8XY0) X(8XY1) X(8XY2) X(8XY3) X(8XY4) X(8XY5) X(8XY6) X(8XY7) X(8XYE) \
+    X(9XY0) X(ANNN) X(BNNN) X(CXNN) X(DXYN) X(EX9E) X(EXA1) \
+    X(FX07) X(FX0A) X(FX15) X(FX18) X(FX1E) X(FX29) X(FX33) X(FX55) X(FX65) \
+    X(00CN) X(00FB) X(00FC) X(00FD) X(00FE) X(00FF) X(DXY0) X(FX30) X(FX75) X(FX85) \
+    X(00DN) X(5XY2) X(5XY3) X(F000) X(FN01) X(F002) X(FX3A)
+
+enum OpKind : BYTE {
+#define CHIP8_OPKIND(name) OP_##name,
+    CHIP8_OPCODES(CHIP8_OPKIND)
+#undef CHIP8_OPKIND
+    OP_COUNT
+};
+
+// An opcode with its fields already pulled out, so handlers never have to mask and shift.
+struct Instruction {
+    BYTE kind;    // OpKind
+    BYTE x;       // _X__
+    BYTE y;       // __Y_
+    BYTE n;       // ___N
+    BYTE nn;      // __NN
+    WORD nnn;     // _NNN
+};
+
+// How instructions get from memory to their handlers:
+//   DISPATCH_SWITCH   - the original nested switch in DecodeOpcodeCycle
+//   DISPATCH_TABLE    - look the opcode up in a 64K pre-decoded table, call through a function pointer
+//   DISPATCH_THREADED - the same table, driven by a computed-goto loop (GCC/Clang only)
+//   DISPATCH_JIT      - basic blocks compiled to host code, with an interpreted fallback (see JIT.h)
+enum DispatchMode {
+    DISPATCH_SWITCH,
+    DISPATCH_TABLE,
+    DISPATCH_THREADED,
+    DISPATCH_JIT,
+};
+
+bool IsThreadedDispatchAvailable();
+DispatchMode DefaultDispatchMode();
+const char* DispatchModeName(DispatchMode mode);
+bool ParseDispatchMode(const char* name, DispatchMode& mode);
+
+// Fully decode an opcode, kind included. Used to build the pre-decoded table.
+Instruction DecodeInstruction(WORD opcode);
+
+// Pre-decoded instruction for every possible 16-bit opcode. Shared by every machine.
+const Instruction* GetDecodeTable();
+
+// Read the ROM from disk (only the first time it's asked for) and keep it in a
+// process-wide cache, along with its static analysis (see Analyzer.h). Safe to call from any thread.
+const ROMImage* LoadCH8ROM(const char* fname);
+
+// Whether the ROM fits in the memory its profile can reach: 0xE00 bytes for the 4K
+// profiles, nearly 64K for xochip. Logs an error if it doesn't.
+bool ROMFitsQuirkProfile(const ROMImage& rom, QuirkProfile quirks);
+
+// Writes to memory are tracked at this granularity to decide whether any compiled
+// code needs to be thrown away.
+const int JIT_PAGE_SHIFT = 6;
+const int JIT_PAGE_COUNT = 0x1000 >> JIT_PAGE_SHIFT;
+
+// Number of nested subroutine calls the machine can make. The original COSMAC VIP
+// interpreter had room for 12; 16 is what most later interpreters settled on.
+#ifndef CHIP8_STACK_DEPTH
+#define CHIP8_STACK_DEPTH 16
+#endif
+const int STACK_DEPTH = CHIP8_STACK_DEPTH;
+
+// Something the ROM did that a real machine couldn't have survived. Once a machine
+// faults it stays parked on the faulting instruction until the next CPUReset().
+enum MachineFault : BYTE {
+    FAULT_NONE,
+    FAULT_STACK_OVERFLOW,     // 2NNN with a full stack
+    FAULT_STACK_UNDERFLOW,    // 00EE with an empty stack
+    FAULT_EXIT,               // 00FD, the SCHIP exit instruction
+};
+
+const char* MachineFaultName(MachineFault fault);
+
+// FX0A's wait: not waiting, waiting for any key to go down, or (0-F) waiting for that key to come back up
+const BYTE KEY_WAIT_NONE = 0xFF;
+const BYTE KEY_WAIT_ANY = 0x10;
+
+class JITCache;
+struct MachineSnapshot;
+
+class Chip8 {
+public:
+    Chip8();
+    ~Chip8();
+
+    // The JIT bakes the addresses of our registers into its code, so machines stay put.
+    Chip8(const Chip8&) = delete;
+    Chip8& operator=(const Chip8&) = delete;
+
+    void CPUReset(const ROMImage& rom);
+
+    // Put the machine back to the state it had right after the last CPUReset().
+    // Doesn't touch the filesystem or the ROM cache, so a harness can call this as often as it likes.
+    bool ResetToPristineROM();
+
+    WORD GetNextOpcode();
+    void DecodeOpcodeCycle(WORD opcode);
+
+    // Run count instructions using m_DispatchMode, fast-forwarding through an idle loop
+    // at the start if m_SkipIdleLoops allows. Returns how many the machine got through:
+    // all of them (skipped ones included), or if it faulted, the ones up to and
+    // including the faulting instruction.
+    int RunInstructions(int count);
+
+    // Count the timers down. Called at exactly 60 Hz by whoever drives the machine,
+    // not once per instruction.
+    void TickTimers();
+
+    // FNV-1a hashes for telling runs apart: just the visible screen, or the whole machine
+    // (memory, registers, I, PC, stack, timers and screen).
+    uint64_t HashDisplay() const;
+    uint64_t HashState() const;
+
+    // Save states (see Snapshot.h). Loading one throws away any compiled code.
+    void SaveSnapshot(MachineSnapshot& snapshot) const;
+    void LoadSnapshot(const MachineSnapshot& snapshot);
+
+    // Print the profile counters (see Profile.h). Says so and does nothing else if
+    // profiling wasn't compiled in.
+    void DumpProfile(FILE* out) const;
+
+    // Opcode handlers, one instantiation per quirk profile (see Quirks.h)
+#define CHIP8_DECLARE_HANDLER(name) template <class Quirks> void Opcode##name(const Instruction& ins);
+    CHIP8_OPCODES(CHIP8_DECLARE_HANDLER)
+#undef CHIP8_DECLARE_HANDLER
+
+    typedef void (*OpcodeHandler)(Chip8& machine, const Instruction& ins);
+
+    // For every quirk profile, a handler for every OpKind in enum order. Plain function
+    // pointers (rather than member function pointers) so the table dispatcher and the
+    // JIT can call them directly.
+    static const OpcodeHandler* const s_OpcodeHandlers[QUIRK_PROFILE_COUNT];
+
+    // The handlers for m_Quirks
+    const OpcodeHandler* Handlers() const { return s_OpcodeHandlers[m_Quirks]; }
+
+    // Memory, registers, and all that good stuff. Only XO-CHIP can reach past 4K.
+    std::array<BYTE, MEMORY_SIZE> m_GameMemory;
+    std::array<BYTE, 16> m_Registers;
+    std::array<BYTE, 16> m_Keyboard;
+    WORD m_AddressI = 0;
+    WORD m_PC = 0x200;
+    std::array<WORD, STACK_DEPTH> m_Stack;
+    BYTE m_SP = 0;
+
+    MachineFault m_Fault = FAULT_NONE;
+    WORD m_FaultPC = 0;
+
+    // How many times an opcode that doesn't decode was run (and skipped) since the
+    // last CPUReset(). Not part of the machine state: snapshots and hashes leave it out.
+    uint64_t m_UnknownOpcodes = 0;
+
+    // Where FX0A is in its wait (see KEY_WAIT_NONE). While it waits the PC stays on it.
+    BYTE m_KeyWait = KEY_WAIT_NONE;
+
+    // Whether the machine is sitting in FX0A. Until a key changes it will do nothing
+    // but count the timers down, so a host may stop running it in the meantime.
+    bool IsWaitingForKey() const { return m_KeyWait != KEY_WAIT_NONE; }
+
+    // Idle loops: a short loop that only reads the delay timer, the keys and registers
+    // (say FX07 / 3X00 / 1NNN, or a jump to itself) does exactly the same thing every time
+    // round until the next timer tick or key change, and neither can happen in the middle
+    // of a RunInstructions() call. When one is found where a call starts, the rounds
+    // left in the call are skipped, leaving the machine exactly as running them would
+    // have. On unless profiling, where every instruction should be counted; turn it off
+    // to check that it makes no difference.
+    bool m_SkipIdleLoops = !MachineProfiler::enabled;
+
+    // Instructions skipped that way since the last CPUReset(). Not part of the machine state.
+    uint64_t m_SkippedInstructions = 0;
+
+    // Timers!
+    uint8_t delayTimer = 0;
+    uint8_t soundTimer = 0;
+
+    // Where CXNN gets its numbers. CPUReset() reseeds it from m_RandomSeed, so every
+    // run of a ROM with the same seed (and input) is the same run.
+    PCG32 m_Random;
+    uint64_t m_RandomSeed = DEFAULT_RANDOM_SEED;
+
+    // SCHIP's RPL user flags (FX75/FX85). XO-CHIP has 16 of them.
+    std::array<BYTE, 16> m_FlagRegisters;
+
+    // XO-CHIP sound: a 128 bit pattern (F002) played at 4000 * 2^((pitch - 64) / 48) Hz (FX3A).
+    // The beeper doesn't play it yet, but ROMs can set and rely on it.
+    std::array<BYTE, 16> m_AudioPattern;
+    BYTE m_AudioPitch = 64;
+
+    // The screen itself, one bit per pixel, plus which rows changed since the last present. See Display.h.
+    // Everything before XO-CHIP only ever uses the first plane; FN01 picks which ones
+    // get drawn, cleared and scrolled.
+    DisplayPlane m_Display;
+    DisplayPlane m_SecondPlane;
+    BYTE m_PlaneMask = 1;
+
+    // Which interpreter's opinion on the ambiguous opcodes this machine follows.
+    // Can be changed between batches; the JIT recompiles when it notices.
+    QuirkProfile m_Quirks = QUIRKS_LEGACY;
+
+    DispatchMode m_DispatchMode;
+
+    // Non-zero for every page of memory that has JIT code compiled from it.
+    std::array<BYTE, JIT_PAGE_COUNT> m_JITCodePages;
+
+    // Empty unless built with CHIP8_PROFILE. Cleared by CPUReset().
+    MachineProfiler m_Profiler;
+
+private:
+    void BuildPristineMemory(const ROMImage& rom);
+
+    // Run up to count instructions looking for an idle loop starting at the PC, and skip
+    // as many whole rounds of it as fit in what's left. Returns the instructions used up,
+    // run or skipped. See m_SkipIdleLoops.
+    int SkipIdleLoop(int count);
+
+    // Run one round of a would-be idle loop starting at the PC, adding every instruction
+    // run to ran. Returns its length, or 0 if it came to something an idle loop can't
+    // contain (which isn't run) or didn't get back within limit.
+    int RunIdleRound(int limit, int& ran);
+
+    // Record the fault and rewind the PC onto the instruction that caused it, so
+    // whatever is left of the current batch just keeps hitting the same fault.
+    // Every retry after the first raises it again, and gets counted in m_FaultRetries.
+    void RaiseFault(MachineFault fault) {
+        m_PC -= 2;
+        m_FaultRetries += m_Fault != FAULT_NONE;
+        m_Fault = fault;
+        m_FaultPC = m_PC;
+    }
+
+    // Times the faulting instruction ran again in the current RunInstructions() call
+    int m_FaultRetries = 0;
+
+    // Called by the handlers that write to memory (FX33, FX55, 5XY2) through
+    // NoteStoreAtI. Only pays for a lookup unless the write actually lands on compiled code.
+    void NoteCodeWrite(int address, int length) {
+        int first = (address >> JIT_PAGE_SHIFT) & (JIT_PAGE_COUNT - 1);
+        int last = ((address + length - 1) >> JIT_PAGE_SHIFT) & (JIT_PAGE_COUNT - 1);
+        if (m_JITCodePages[first] | m_JITCodePages[last]) {
+            InvalidateCode(address, length);
+        }
+    }
+    void InvalidateCode(int address, int length);
+
+    // length bytes were just stored at I, each wrapped to the profile's memory the way
+    // the handlers wrap them. A store that runs off the top carries on at address 0.
+    template <class Quirks> void NoteStoreAtI(int length) {
+        int address = m_AddressI & Quirks::memoryMask;
+        int head = std::min(length, Quirks::memoryMask + 1 - address);
+        NoteCodeWrite(address, head);
+        if (head < length) {
+            NoteCodeWrite(0, length - head);
+        }
+    }
+
+    template <class Quirks> void DecodeSwitch(WORD opcode);
+
+    // Skip the next instruction; under XO-CHIP that's four bytes if it's an F000 NNNN.
+    template <class Quirks> void SkipNextInstruction();
+
+    // EX9E and EXA1's key test
+    template <class Quirks> bool IsKeyInVXDown(const Instruction& ins) const;
+
+    // DXYN and DXY0 on every selected plane
+    template <class Quirks> void DrawOnPlanes(const Instruction& ins, int rows, bool wide);
+
+    // Run f on every plane selected by m_PlaneMask
+    template <typename F> void ForEachSelectedPlane(F f) {
+        if (m_PlaneMask & 1) {
+            f(m_Display);
+        }
+        if (m_PlaneMask & 2) {
+            f(m_SecondPlane);
+        }
+    }
+    void SetResolution(int width, int height) {
+        m_Display.SetResolution(width, height);
+        m_SecondPlane.SetResolution(width, height);
+    }
+
+    template <class Quirks> void RunSwitch(int count);
+    void RunTable(int count);
+    template <class Quirks> void RunThreaded(int count);
+
+    // Memory exactly as it looks right after a reset: fonts + the current ROM at 0x200.
+    // It is built once per ROM so CPUReset() only has to do a single copy.
+    std::array<BYTE, MEMORY_SIZE> m_PristineMemory;
+    const ROMImage* m_PristineROM = nullptr;
+
+    // Created the first time the machine runs in DISPATCH_JIT
+    std::unique_ptr<JITCache> m_JIT;
+};
@@ -0,0 +1,464 @@
+#include "Debugger.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET Socket;
+static int CloseSocket(Socket s) { return closesocket(s); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int Socket;
+static int CloseSocket(Socket s) { return close(s); }
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const intptr_t NO_SOCKET = -1;
+
+// How often the server thread looks up from its sockets to see if it should stop
+static const int POLL_INTERVAL_MS = 100;
+
+// A client sending more than this without a newline, or this many lines the emulation
+// thread hasn't got to yet, is cut off.
+static const size_t MAX_REQUEST_SIZE = 4096;
+static const size_t MAX_PENDING_REQUESTS = 256;
+
+static const int MAX_MEMORY_DUMP = 4096;
+
+static std::string Format(const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return buffer;
+}
+
+// Just enough JSON for the requests: find "key" and read the string or number after its colon.
+static const char* FindJSONValue(const std::string& json, const char* key) {
+    std::string quoted = std::string("\"") + key + "\"";
+    size_t at = json.find(quoted);
+    if (at == std::string::npos) {
+        return nullptr;
+    }
+    at = json.find_first_not_of(" \t", at + quoted.size());
+    if (at == std::string::npos || json[at] != ':') {
+        return nullptr;
+    }
+    at = json.find_first_not_of(" \t", at + 1);
+    return at == std::string::npos ? nullptr : json.c_str() + at;
+}
+
+static std::string JSONString(const std::string& json, const char* key) {
+    const char* value = FindJSONValue(json, key);
+    if (!value || *value != '"') {
+        return "";
+    }
+    const char* end = strchr(value + 1, '"');
+    return end ? std::string(value + 1, end) : "";
+}
+
+static bool JSONNumber(const std::string& json, const char* key, int& number) {
+    const char* value = FindJSONValue(json, key);
+    if (!value) {
+        return false;
+    }
+    char* end = nullptr;
+    long parsed = strtol(value, &end, 10);
+    if (end == value) {
+        return false;
+    }
+    number = (int)parsed;
+    return true;
+}
+
+// Wait up to timeoutMs for a socket to have something to read (or accept).
+static bool WaitReadable(intptr_t s, int timeoutMs) {
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET((Socket)s, &readable);
+    timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+    return select((int)s + 1, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+DebugServer::DebugServer()
+    : m_Listener(NO_SOCKET), m_Client(NO_SOCKET), m_Breakpoints(MEMORY_SIZE, false) {
+}
+
+DebugServer::~DebugServer() {
+    Stop();
+}
+
+bool DebugServer::Start(int port) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        LOG_ERROR("Unable to start Winsock for the debug server");
+        return false;
+    }
+#endif
+
+    Socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == (Socket)NO_SOCKET) {
+        LOG_ERROR("Unable to create the debug server's socket");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    // Local connections only: anyone who can reach the port can rewrite the machine.
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        LOG_ERROR("Unable to listen for a debugger on port %d", port);
+        CloseSocket(listener);
+        return false;
+    }
+
+    m_Listener = (intptr_t)listener;
+    m_Stopping.store(false);
+    m_Thread = std::thread(&DebugServer::Serve, this);
+    LOG_INFO("Debug server listening on 127.0.0.1:%d", port);
+    return true;
+}
+
+void DebugServer::Stop() {
+    if (!m_Thread.joinable()) {
+        return;
+    }
+    m_Stopping.store(true);
+    m_Thread.join();
+    Detach();
+    CloseSocket((Socket)m_Listener);
+    m_Listener = NO_SOCKET;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void DebugServer::Notify() {
+    m_RequestArrived.notify_one();
+    if (m_Wake) {
+        m_Wake();
+    }
+}
+
+void DebugServer::Attach(intptr_t client) {
+    {
+        std::lock_guard<std::mutex> lock(m_SendMutex);
+        m_Client = client;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Requests.clear();
+        m_Session++;
+    }
+    m_Attached.store(true);
+    LOG_INFO("Debugger attached");
+    Send("{\"event\": \"hello\", \"version\": 1}");
+    Notify();
+}
+
+void DebugServer::Detach() {
+    {
+        std::lock_guard<std::mutex> lock(m_SendMutex);
+        if (m_Client == NO_SOCKET) {
+            return;
+        }
+        CloseSocket((Socket)m_Client);
+        m_Client = NO_SOCKET;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Requests.clear();
+        m_Session++;
+    }
+    m_Attached.store(false);
+    LOG_INFO("Debugger detached");
+    Notify();
+}
+
+void DebugServer::Serve() {
+    std::string received;
+    while (!m_Stopping.load(std::memory_order_relaxed)) {
+        if (!IsAttached()) {
+            if (WaitReadable(m_Listener, POLL_INTERVAL_MS)) {
+                Socket client = accept((Socket)m_Listener, nullptr, nullptr);
+                if (client != (Socket)NO_SOCKET) {
+                    received.clear();
+                    Attach((intptr_t)client);
+                }
+            }
+            continue;
+        }
+
+        if (!WaitReadable(m_Client, POLL_INTERVAL_MS)) {
+            continue;
+        }
+        char chunk[1024];
+        int length = (int)recv((Socket)m_Client, chunk, sizeof(chunk), 0);
+        if (length <= 0) {
+            Detach();
+            continue;
+        }
+        received.append(chunk, length);
+
+        // Hand over every complete line.
+        bool overflow = false;
+        size_t end;
+        while ((end = received.find('\n')) != std::string::npos) {
+            std::string line = received.substr(0, end);
+            received.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Requests.size() >= MAX_PENDING_REQUESTS) {
+                overflow = true;
+                break;
+            }
+            m_Requests.push_back(line);
+            m_RequestsPending.store(true, std::memory_order_release);
+        }
+        if (overflow || received.size() > MAX_REQUEST_SIZE) {
+            LOG_WARN("Debugger sent too much at once, disconnecting it");
+            Detach();
+            continue;
+        }
+        Notify();
+    }
+}
+
+void DebugServer::Send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(m_SendMutex);
+    if (m_Client == NO_SOCKET) {
+        return;
+    }
+    std::string out = line + "\n";
+    for (size_t sent = 0; sent < out.size();) {
+        int n = (int)send((Socket)m_Client, out.data() + sent, (int)(out.size() - sent), MSG_NOSIGNAL);
+        if (n <= 0) {
+
+            // The server thread notices the dead connection on its next read.
+            return;
+        }
+        sent += n;
+    }
+}
+
+void DebugServer::StopAt(const char* reason, const Chip8& machine, int address) {
+    m_Paused = true;
+    m_StepsLeft = 0;
+    if (address >= 0) {
+        Send(Format("{\"event\": \"%s\", \"pc\": %d, \"addr\": %d}", reason, machine.m_PC, address));
+    }
+    else {
+        Send(Format("{\"event\": \"%s\", \"pc\": %d}", reason, machine.m_PC));
+    }
+}
+
+bool DebugServer::HitsBreakOrWatch(const Chip8& machine) {
+    if (m_BreakpointCount > 0 && m_Breakpoints[machine.m_PC]) {
+        StopAt("break", machine);
+        return true;
+    }
+    if (m_Watchpoints.empty()) {
+        return false;
+    }
+
+    // Only FX33, FX55 and 5XY2 write to memory, all of them starting at I.
+    WORD opcode = (WORD)((machine.m_GameMemory[machine.m_PC] << 8) | machine.m_GameMemory[(WORD)(machine.m_PC + 1)]);
+    const Instruction& ins = GetDecodeTable()[opcode];
+    int length = 0;
+    switch (ins.kind) {
+        case OP_FX33: length = 3; break;
+        case OP_FX55: length = ins.x + 1; break;
+        case OP_5XY2: length = std::abs(ins.x - ins.y) + 1; break;
+        default: return false;
+    }
+    // Each byte lands where the handler's store puts it, wrapped to the memory the
+    // profile can reach.
+    const int mask = (int)QuirkMemorySize(machine.m_Quirks) - 1;
+    for (int i = 0; i < length; i++) {
+        int address = (machine.m_AddressI + i) & mask;
+        for (const Watchpoint& watch : m_Watchpoints) {
+            if (watch.address <= address && address < watch.address + watch.length) {
+                StopAt("watch", machine, address);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void DebugServer::HandleRequests(Chip8& machine) {
+    std::deque<std::string> requests;
+    uint32_t session;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        requests.swap(m_Requests);
+        m_RequestsPending.store(false, std::memory_order_relaxed);
+        session = m_Session.load();
+    }
+
+    // A new client (or none) starts from a clean slate, running.
+    if (session != m_SeenSession) {
+        m_SeenSession = session;
+        std::fill(m_Breakpoints.begin(), m_Breakpoints.end(), false);
+        m_BreakpointCount = 0;
+        m_Watchpoints.clear();
+        m_Paused = false;
+        m_StepsLeft = 0;
+        m_Resuming = false;
+    }
+
+    for (const std::string& request : requests) {
+        HandleRequest(machine, request);
+    }
+}
+
+void DebugServer::HandleRequest(Chip8& machine, const std::string& request) {
+    std::string command = JSONString(request, "cmd");
+    int pc = 0, address = 0, length = 0, count = 1;
+
+    if (command == "pause") {
+        StopAt("paused", machine);
+    }
+    else if (command == "continue") {
+        m_Paused = false;
+        m_StepsLeft = 0;
+        m_Resuming = true;
+        Send("{\"ok\": true}");
+    }
+    else if (command == "step") {
+        JSONNumber(request, "count", count);
+        m_Paused = true;
+        m_StepsLeft = std::max(count, 1);
+        m_Resuming = true;
+        Send("{\"ok\": true}");
+    }
+    else if ((command == "break" || command == "delete") && JSONNumber(request, "pc", pc) &&
+             pc >= 0 && pc < (int)MEMORY_SIZE) {
+        bool set = command == "break";
+        if (m_Breakpoints[pc] != set) {
+            m_Breakpoints[pc] = set;
+            m_BreakpointCount += set ? 1 : -1;
+        }
+        Send("{\"ok\": true}");
+    }
+    else if (command == "watch" && JSONNumber(request, "addr", address)) {
+        length = 1;
+        JSONNumber(request, "len", length);
+        m_Watchpoints.push_back({ address, std::max(length, 1) });
+        Send("{\"ok\": true}");
+    }
+    else if (command == "unwatch" && JSONNumber(request, "addr", address)) {
+        m_Watchpoints.erase(std::remove_if(m_Watchpoints.begin(), m_Watchpoints.end(),
+                                           [address](const Watchpoint& watch) { return watch.address == address; }),
+                            m_Watchpoints.end());
+        Send("{\"ok\": true}");
+    }
+    else if (command == "regs") {
+        std::string reply = Format("{\"pc\": %d, \"i\": %d, \"sp\": %d, \"dt\": %d, \"st\": %d, \"paused\": %s, \"fault\": \"%s\", \"v\": [",
+                                   machine.m_PC, machine.m_AddressI, machine.m_SP, machine.delayTimer,
+                                   machine.soundTimer, m_Paused ? "true" : "false", MachineFaultName(machine.m_Fault));
+        for (int i = 0; i < 16; i++) {
+            reply += Format(i ? ", %d" : "%d", machine.m_Registers[i]);
+        }
+        reply += "], \"stack\": [";
+        for (int i = 0; i < machine.m_SP; i++) {
+            reply += Format(i ? ", %d" : "%d", machine.m_Stack[i]);
+        }
+        Send(reply + "]}");
+    }
+    else if (command == "memory" && JSONNumber(request, "addr", address) && address >= 0 && address < (int)MEMORY_SIZE) {
+        length = 16;
+        JSONNumber(request, "len", length);
+        length = std::max(0, std::min({ length, MAX_MEMORY_DUMP, (int)MEMORY_SIZE - address }));
+        std::string reply = Format("{\"addr\": %d, \"data\": \"", address);
+        for (int i = 0; i < length; i++) {
+            reply += Format("%02x", machine.m_GameMemory[address + i]);
+        }
+        Send(reply + "\"}");
+    }
+    else if (command == "screen") {
+        const DisplayPlane* planes[2] = { &machine.m_Display, &machine.m_SecondPlane };
+        std::string reply = Format("{\"width\": %d, \"height\": %d, \"planes\": [", machine.m_Display.width, machine.m_Display.height);
+        for (int plane = 0; plane < 2; plane++) {
+            reply += plane ? "], [" : "[";
+            for (int y = 0; y < planes[plane]->height; y++) {
+                reply += y ? ", \"" : "\"";
+                for (int w = 0; w < planes[plane]->WordsPerRow(); w++) {
+                    reply += Format("%016llx", (unsigned long long)planes[plane]->Row(y)[w]);
+                }
+                reply += "\"";
+            }
+        }
+        Send(reply + "]]}");
+    }
+    else {
+        Send("{\"error\": \"bad request\"}");
+    }
+}
+
+int DebugServer::RunFrame(Chip8& machine, int count, const std::atomic<bool>& stopping) {
+    int done = 0;
+    int ran = 0;
+    while (done < count && !stopping.load(std::memory_order_relaxed)) {
+        HandleRequests(machine);
+        if (!IsAttached()) {
+            return ran + machine.RunInstructions(count - done);
+        }
+
+        // Stopped: sleep until the debugger says something.
+        if (m_Paused && m_StepsLeft == 0) {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_RequestArrived.wait_for(lock, std::chrono::milliseconds(POLL_INTERVAL_MS),
+                                      [this] { return !m_Requests.empty() || !IsAttached(); });
+            continue;
+        }
+
+        // Run until something stops us, a request comes in or the frame is done.
+        while (done < count && !m_RequestsPending.load(std::memory_order_acquire)) {
+            if (machine.m_Fault != FAULT_NONE) {
+                done = count;
+                break;
+            }
+            if (!m_Resuming && HitsBreakOrWatch(machine)) {
+                break;
+            }
+            m_Resuming = false;
+
+            ran += machine.RunInstructions(1);
+            done++;
+            if (machine.m_Fault != FAULT_NONE) {
+                StopAt("fault", machine);
+                break;
+            }
+            if (m_StepsLeft > 0 && --m_StepsLeft == 0) {
+                StopAt("step", machine);
+                break;
+            }
+        }
+    }
+    return ran;
+}
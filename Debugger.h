@@ -0,0 +1,110 @@
+#pragma once
+
+// Debug server
+// With --debug-port N the windowed build listens on 127.0.0.1:N for one debugger at a
+// time. Both ways it's one JSON object per line. Requests are {"cmd": ...} plus
+// whatever numbers the command takes:
+//
+//   pause                        stop before the next instruction
+//   continue                     carry on at full speed
+//   step      [count]            run count instructions (default 1), then stop
+//   break     pc / delete pc     set or clear a breakpoint on an address
+//   watch     addr [len]         stop before anything writes to [addr, addr + len)
+//   unwatch   addr               clear the watchpoints starting at addr
+//   regs                         V0-VF, I, PC, SP, the stack, the timers and any fault
+//   memory    addr [len]         len bytes (default 16, at most 4096) as hex
+//   screen                       both display planes, one hex string per row
+//
+// Every request gets one line back, {"ok": true} or the data asked for, or {"error": ...}.
+// Stopping is announced on its own line: {"event": "break" | "watch" | "step" |
+// "paused" | "fault", "pc": ...}. Numbers are plain decimal, as JSON has them.
+//
+// While nobody's connected the emulation thread doesn't call in here at all, so the
+// only cost is one atomic load per frame. Once someone is, their frames run one
+// instruction at a time through RunFrame() so breakpoints and watchpoints can be checked
+// in between. A stopped machine stops mid-frame: the timers only tick once the frame's
+// instructions have all run, just as if it had never stopped.
+
+#include "Chip8.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class DebugServer {
+public:
+    DebugServer();
+    ~DebugServer();
+    DebugServer(const DebugServer&) = delete;
+    DebugServer& operator=(const DebugServer&) = delete;
+
+    // Listen on 127.0.0.1:port and serve clients from a thread of our own.
+    bool Start(int port);
+    void Stop();
+
+    // Called from the server thread when a request comes in or a client comes or goes,
+    // so a parked emulation thread wakes up to see it. Only before Start().
+    void SetWakeCallback(std::function<void()> wake) { m_Wake = std::move(wake); }
+
+    bool IsAttached() const { return m_Attached.load(std::memory_order_relaxed); }
+
+    // Emulation thread: run count instructions of the current frame, answering requests
+    // and stopping where the debugger says to. Returns once they've all run (or the
+    // machine faulted, or stopping was set), blocking for as long as the machine is stopped.
+    // The result is how many ran, counted the way RunInstructions() counts them.
+    int RunFrame(Chip8& machine, int count, const std::atomic<bool>& stopping);
+
+private:
+    struct Watchpoint {
+        int address;
+        int length;
+    };
+
+    // Server thread
+    void Serve();
+    void Attach(intptr_t client);
+    void Detach();
+    void Notify();
+
+    // Either thread. Drops the line if nobody's connected.
+    void Send(const std::string& line);
+
+    // Emulation thread
+    void HandleRequests(Chip8& machine);
+    void HandleRequest(Chip8& machine, const std::string& request);
+    void StopAt(const char* reason, const Chip8& machine, int address = -1);
+    bool HitsBreakOrWatch(const Chip8& machine);
+
+    // Sockets and the server thread
+    intptr_t m_Listener;
+    intptr_t m_Client;
+    std::mutex m_SendMutex;
+    std::thread m_Thread;
+    std::atomic<bool> m_Stopping{ false };
+    std::atomic<bool> m_Attached{ false };
+    std::function<void()> m_Wake;
+
+    // Lines from the client, waiting for the emulation thread. The session number goes
+    // up every time a client comes or goes, and tells the emulation thread to start over.
+    std::mutex m_Mutex;
+    std::condition_variable m_RequestArrived;
+    std::deque<std::string> m_Requests;
+    std::atomic<bool> m_RequestsPending{ false };
+    std::atomic<uint32_t> m_Session{ 0 };
+
+    // The debugger's view of things, touched only on the emulation thread
+    uint32_t m_SeenSession = 0;
+    std::vector<bool> m_Breakpoints;
+    int m_BreakpointCount = 0;
+    std::vector<Watchpoint> m_Watchpoints;
+    bool m_Paused = false;
+    int m_StepsLeft = 0;
+
+    // Resuming from a stop runs the instruction it stopped on without stopping on it again.
+    bool m_Resuming = false;
+};
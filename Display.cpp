@@ -0,0 +1,171 @@
+#include "Display.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_DISPLAY_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CHIP8_DISPLAY_NEON
+#include <arm_neon.h>
+#endif
+
+// Tallest sprite a DXYN can draw
+const int MAX_SPRITE_ROWS = 16;
+
+uint64_t DisplayPlane::LitRows() const {
+    const int wordsPerRow = WordsPerRow();
+    uint64_t rows = 0;
+    for (int y = 0; y < height; y++) {
+        uint64_t lit = 0;
+        for (int w = 0; w < wordsPerRow; w++) {
+            lit |= words[y * wordsPerRow + w];
+        }
+        if (lit) {
+            rows |= 1ull << y;
+        }
+    }
+    return rows;
+}
+
+void DisplayPlane::Clear() {
+    dirtyRows |= LitRows();
+    memset(words, 0, sizeof(words));
+}
+
+void DisplayPlane::SetResolution(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    memset(words, 0, sizeof(words));
+    MarkAllDirty();
+}
+
+// Rows are contiguous, so a vertical scroll is one memmove.
+void DisplayPlane::ScrollDown(int rows) {
+    const int wordsPerRow = WordsPerRow();
+    rows = rows < height ? rows : height;
+    uint64_t lit = LitRows();
+
+    memmove(words + rows * wordsPerRow, words, (height - rows) * wordsPerRow * sizeof(uint64_t));
+    memset(words, 0, rows * wordsPerRow * sizeof(uint64_t));
+    dirtyRows |= lit | (rows < 64 ? lit << rows : 0);
+}
+
+void DisplayPlane::ScrollUp(int rows) {
+    const int wordsPerRow = WordsPerRow();
+    rows = rows < height ? rows : height;
+    uint64_t lit = LitRows();
+
+    memmove(words, words + rows * wordsPerRow, (height - rows) * wordsPerRow * sizeof(uint64_t));
+    memset(words + (height - rows) * wordsPerRow, 0, rows * wordsPerRow * sizeof(uint64_t));
+    dirtyRows |= lit | (rows < 64 ? lit >> rows : 0);
+}
+
+// Horizontal scrolls shift every word of a row by 4, carrying the bits that cross
+// into the neighbouring word.
+void DisplayPlane::ScrollRight() {
+    const int wordsPerRow = WordsPerRow();
+    dirtyRows |= LitRows();
+    for (int y = 0; y < height; y++) {
+        uint64_t* row = words + y * wordsPerRow;
+        for (int w = wordsPerRow - 1; w >= 0; w--) {
+            row[w] = (row[w] >> 4) | (w > 0 ? row[w - 1] << 60 : 0);
+        }
+    }
+}
+
+void DisplayPlane::ScrollLeft() {
+    const int wordsPerRow = WordsPerRow();
+    dirtyRows |= LitRows();
+    for (int y = 0; y < height; y++) {
+        uint64_t* row = words + y * wordsPerRow;
+        for (int w = 0; w < wordsPerRow; w++) {
+            row[w] = (row[w] << 4) | (w + 1 < wordsPerRow ? row[w + 1] >> 60 : 0);
+        }
+    }
+}
+
+bool XorBlit(uint64_t* dst, const uint64_t* src, int count) {
+    int i = 0;
+
+#if defined(CHIP8_DISPLAY_SSE2)
+    __m128i hits = _mm_setzero_si128();
+    for (; i + 2 <= count; i += 2) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        hits = _mm_or_si128(hits, _mm_and_si128(d, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, s));
+    }
+    bool collision = _mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128())) != 0xFFFF;
+#elif defined(CHIP8_DISPLAY_NEON)
+    uint64x2_t hits = vdupq_n_u64(0);
+    for (; i + 2 <= count; i += 2) {
+        uint64x2_t d = vld1q_u64(dst + i);
+        uint64x2_t s = vld1q_u64(src + i);
+        hits = vorrq_u64(hits, vandq_u64(d, s));
+        vst1q_u64(dst + i, veorq_u64(d, s));
+    }
+    bool collision = (vgetq_lane_u64(hits, 0) | vgetq_lane_u64(hits, 1)) != 0;
+#else
+    bool collision = false;
+#endif
+
+    // Whatever is left over (or everything, without SIMD)
+    for (; i < count; i++) {
+        collision |= (dst[i] & src[i]) != 0;
+        dst[i] ^= src[i];
+    }
+    return collision;
+}
+
+bool DisplayPlane::DrawSprite(const BYTE* sprite, int x, int y, int rows, bool wrap, bool wide) {
+    const int wordsPerRow = WordsPerRow();
+
+    x %= width;
+    y %= height;
+    if (rows > MAX_SPRITE_ROWS) {
+        rows = MAX_SPRITE_ROWS;
+    }
+
+    // Without wrapping, rows past the bottom edge are simply dropped.
+    if (!wrap && y + rows > height) {
+        rows = height - y;
+    }
+
+    // Build the XOR masks for every row first, laid out exactly like the plane,
+    // so the whole sprite can be blitted in one go.
+    uint64_t masks[MAX_SPRITE_ROWS * DISPLAY_MAX_WIDTH / 64] = {};
+    const int word = x >> 6;
+    const int bit = x & 63;
+
+    for (int r = 0; r < rows; r++) {
+
+        // Sprite row, left aligned so its first pixel sits in bit 63
+        uint64_t pattern = wide ? (uint64_t)((sprite[r * 2] << 8) | sprite[r * 2 + 1]) << 48
+                                : (uint64_t)sprite[r] << 56;
+        if (pattern) {
+            dirtyRows |= 1ull << ((y + r) % height);
+        }
+        uint64_t* rowMasks = masks + r * wordsPerRow;
+
+        rowMasks[word] = pattern >> bit;
+
+        // Pixels that spill into the next word. In the last word of a row they either
+        // wrap back to the first word or fall off the screen.
+        uint64_t spill = bit ? pattern << (64 - bit) : 0;
+        if (word + 1 < wordsPerRow) {
+            rowMasks[word + 1] = spill;
+        }
+        else if (wrap) {
+            rowMasks[0] |= spill;
+        }
+    }
+
+    // Rows are contiguous in memory, so unless the sprite wraps past the bottom edge
+    // this is a single blit. Otherwise it's two: the bottom part, then the top.
+    int firstRows = (y + rows > height) ? height - y : rows;
+    bool collision = XorBlit(words + y * wordsPerRow, masks, firstRows * wordsPerRow);
+    if (firstRows < rows) {
+        collision |= XorBlit(words, masks + firstRows * wordsPerRow, (rows - firstRows) * wordsPerRow);
+    }
+    return collision;
+}
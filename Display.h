@@ -0,0 +1,70 @@
+#pragma once
+
+// Packed display plane
+// Every pixel is one bit. A row is one uint64_t in the regular 64x32 mode, or two in the
+// 128x64 SCHIP mode, with bit 63 of the first word being the leftmost pixel. Drawing a
+// sprite row is then a shift and an XOR, collisions fall out of an AND, and the SCHIP
+// scrolls are word shifts and memmoves. XO-CHIP's second bitplane is just another plane.
+
+#include "Types.h"
+#include <cstdint>
+
+const int DISPLAY_MAX_WIDTH = 128;
+const int DISPLAY_MAX_HEIGHT = 64;
+const int DISPLAY_MAX_WORDS = DISPLAY_MAX_WIDTH * DISPLAY_MAX_HEIGHT / 64;
+
+// XO-CHIP draws on up to two planes at once
+const int DISPLAY_PLANES = 2;
+
+struct DisplayPlane {
+    alignas(16) uint64_t words[DISPLAY_MAX_WORDS];
+    int width = 64;
+    int height = 32;
+
+    // Bit y is set when row y may have changed since the last TakeDirtyRows().
+    // DISPLAY_MAX_HEIGHT is 64, so every row fits in one word.
+    uint64_t dirtyRows = ~0ull;
+
+    int WordsPerRow() const { return width / 64; }
+    int WordCount() const { return WordsPerRow() * height; }
+    const uint64_t* Row(int y) const { return words + y * WordsPerRow(); }
+
+    // Blank the whole plane. Only rows that had something lit are marked dirty.
+    void Clear();
+
+    // Switch between 64x32 and 128x64. The plane is blanked and every row marked dirty.
+    void SetResolution(int newWidth, int newHeight);
+
+    // SCHIP/XO-CHIP scrolls. Pixels scrolled off an edge are lost and blank ones come in
+    // from the other side. The horizontal ones always move 4 pixels.
+    void ScrollDown(int rows);
+    void ScrollUp(int rows);
+    void ScrollRight();
+    void ScrollLeft();
+
+    // Bit y is set if row y has any pixel lit.
+    uint64_t LitRows() const;
+
+    void MarkAllDirty() { dirtyRows = ~0ull; }
+    uint64_t TakeDirtyRows() {
+        uint64_t rows = dirtyRows;
+        dirtyRows = 0;
+        return rows;
+    }
+
+    bool GetPixel(int x, int y) const {
+        uint64_t word = Row(y)[x >> 6];
+        return (word >> (63 - (x & 63))) & 1;
+    }
+
+    // XOR an 8 pixel wide sprite, one byte per row, onto the plane at (x, y). With wide
+    // set it's 16 pixels wide instead, two bytes per row (DXY0).
+    // The start position always wraps around the screen. With wrap set, pixels that
+    // run off an edge come back on the other side; otherwise they are clipped.
+    // Marks the rows it touched dirty. Returns true if any lit pixel got turned off.
+    bool DrawSprite(const BYTE* sprite, int x, int y, int rows, bool wrap, bool wide = false);
+};
+
+// XOR count words of src into dst and report whether any bit was set in both.
+// Uses SSE2 or NEON when the compiler has them.
+bool XorBlit(uint64_t* dst, const uint64_t* src, int count);
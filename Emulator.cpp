@@ -0,0 +1,191 @@
+#include "Emulator.h"
+#include "Log.h"
+#include <cstring>
+
+EmulationThread::EmulationThread(Chip8& machine, FrameScheduler& scheduler, InputQueue& input)
+    : m_Machine(machine), m_Scheduler(scheduler), m_Input(input) {
+}
+
+EmulationThread::~EmulationThread() {
+    Stop();
+}
+
+void EmulationThread::Start() {
+    if (m_Thread.joinable()) {
+        return;
+    }
+    m_Stopping.store(false);
+    m_Thread = std::thread(&EmulationThread::Loop, this);
+}
+
+void EmulationThread::Stop() {
+    if (m_Thread.joinable()) {
+        m_Stopping.store(true);
+        Wake();
+        m_Thread.join();
+    }
+}
+
+void EmulationThread::Debug(DebugServer* server) {
+    m_Debugger = server;
+    if (server) {
+        server->SetWakeCallback([this] { Wake(); });
+    }
+}
+
+bool EmulationThread::Post(EmulatorCommand command) {
+    if (!m_Commands.Push(command)) {
+        return false;
+    }
+    Wake();
+    return true;
+}
+
+void EmulationThread::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(m_WakeMutex);
+        m_WakePending = true;
+    }
+    m_Wake.notify_one();
+}
+
+void EmulationThread::Park() {
+    std::unique_lock<std::mutex> lock(m_WakeMutex);
+    m_Wake.wait(lock, [this] { return m_WakePending; });
+}
+
+void EmulationThread::RunCommand(EmulatorCommand command) {
+    if (m_Recorder && (command == COMMAND_QUICK_LOAD || command == COMMAND_REWIND)) {
+        LOG_WARN("Can't jump back in time while recording a movie");
+        return;
+    }
+
+    switch (command) {
+        case COMMAND_QUICK_SAVE:
+            m_Machine.SaveSnapshot(m_QuickSave);
+            m_HasQuickSave = true;
+            break;
+        case COMMAND_QUICK_LOAD:
+            if (m_HasQuickSave) {
+                m_Machine.LoadSnapshot(m_QuickSave);
+            }
+            break;
+        case COMMAND_REWIND:
+            m_Rewind.Rewind(m_Machine);
+            break;
+        case COMMAND_DUMP_PROFILE:
+            m_Machine.DumpProfile(stdout);
+            break;
+        case COMMAND_TOGGLE_TURBO:
+            m_Scheduler.SetSpeed(m_Scheduler.Speed() == 1 ? m_TurboSpeed : 1);
+            m_Speed.store(m_Scheduler.Speed(), std::memory_order_relaxed);
+            break;
+    }
+}
+
+void EmulationThread::Loop() {
+    Chip8& machine = m_Machine;
+
+    // One iteration per 60 Hz frame
+    m_Scheduler.Start();
+    while (!m_Stopping.load(std::memory_order_relaxed)) {
+
+        // Anything pushed from here on wakes the Park() at the end of this frame.
+        {
+            std::lock_guard<std::mutex> lock(m_WakeMutex);
+            m_WakePending = false;
+        }
+
+        EmulatorCommand command;
+        while (m_Commands.Pop(command)) {
+            RunCommand(command);
+        }
+
+        // Key changes land right before this frame's instructions run, at most one per key.
+        ApplyKeyEvents(m_Input, machine);
+        if (m_Recorder) {
+            m_Recorder->BeginFrame(machine);
+        }
+
+        // Run this frame's worth of instructions.
+        int instructions = m_Scheduler.InstructionsThisFrame();
+        uint64_t skippedBefore = machine.m_SkippedInstructions;
+        int ran;
+
+        // With a debugger attached the frame runs an instruction at a time, and may stop partway.
+        if (m_Debugger && m_Debugger->IsAttached()) {
+            ran = m_Debugger->RunFrame(machine, instructions, m_Stopping);
+        }
+        else {
+            ran = machine.RunInstructions(instructions);
+        }
+
+        // Only what was actually executed, so a ROM sitting in a delay loop doesn't
+        // look like it's running any faster.
+        m_InstructionCount.fetch_add(ran - (machine.m_SkippedInstructions - skippedBefore), std::memory_order_relaxed);
+
+        // The machine stops on a fault; say why once and leave the last frame up.
+        if (machine.m_Fault != FAULT_NONE && !m_ReportedFault) {
+            LOG_WARN("Machine fault: %s at %03X", MachineFaultName(machine.m_Fault), machine.m_FaultPC);
+            m_ReportedFault = true;
+        }
+        else if (machine.m_Fault == FAULT_NONE) {
+
+            // A save state or rewind may have brought it back.
+            m_ReportedFault = false;
+        }
+
+        machine.TickTimers();
+        if (m_Recorder) {
+            m_Recorder->EndFrame(machine);
+        }
+        m_SoundActive.store(machine.soundTimer > 0, std::memory_order_relaxed);
+        m_Rewind.OnFrame(machine);
+
+        // Only hand over frames where something actually changed. Rows are versioned
+        // every frame, so a frame skipped here still shows up in the next one handed over.
+        uint64_t dirtyRows = machine.m_Display.TakeDirtyRows() | machine.m_SecondPlane.TakeDirtyRows();
+        if (dirtyRows) {
+            for (int y = 0; y < DISPLAY_MAX_HEIGHT; y++) {
+                if ((dirtyRows >> y) & 1) {
+                    m_RowVersions[y]++;
+                }
+            }
+            m_FramePending = true;
+        }
+
+        // A machine sitting in FX0A with its timers run down does nothing but loop until
+        // a key changes, so once this frame is out, sleep until the main thread has
+        // something for it rather than spinning through frames. Key events held over
+        // for the next frame count as something.
+        bool idle = machine.IsWaitingForKey() && machine.delayTimer == 0 && machine.soundTimer == 0 &&
+                    m_Input.Empty() &&
+                    machine.m_Fault == FAULT_NONE && !(m_Debugger && m_Debugger->IsAttached());
+
+        uint64_t frameCount = m_Scheduler.FrameCount();
+        if (m_FramePending && (idle || frameCount % ((uint64_t)m_FrameSkip * m_Scheduler.Speed()) == 0)) {
+            m_FramePending = false;
+
+            PublishedFrame& frame = m_Frames.Back();
+            frame.display = machine.m_Display;
+            frame.secondPlane = machine.m_SecondPlane;
+            frame.frame = frameCount;
+            memcpy(frame.rowVersions, m_RowVersions, sizeof(m_RowVersions));
+            m_Frames.Publish();
+        }
+
+        m_FrameCount.fetch_add(1, std::memory_order_relaxed);
+        if (m_Export) {
+            m_Export->Publish(machine, m_FrameCount.load(std::memory_order_relaxed),
+                              m_InstructionCount.load(std::memory_order_relaxed));
+        }
+        if (idle) {
+            Park();
+            m_Scheduler.SkipWait();
+        }
+        else {
+            m_Scheduler.WaitForNextFrame();
+        }
+    }
+    m_SoundActive.store(false);
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+// Emulation thread
+// In the windowed build the machine runs on a thread of its own, paced by a
+// FrameScheduler. The main thread only polls events and presents: finished frames cross
+// over through a lock-free triple buffer, key presses come the other way through the
+// InputQueue, and anything else the UI wants done (save states, rewind...) is posted as
+// a command. A present that blocks on vsync never holds up the emulation, and the
+// emulation never waits for a present.
+
+#include "Chip8.h"
+#include "Debugger.h"
+#include "Input.h"
+#include "Movie.h"
+#include "Scheduler.h"
+#include "Snapshot.h"
+#include "StateExport.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// One writer, one reader, and neither ever waits. The writer fills Back() and publishes
+// it; the reader picks up whichever frame was published most recently and keeps it in
+// Front() for as long as it likes. Frames the reader was too slow for are just skipped.
+template <typename T>
+class TripleBuffer {
+public:
+    T& Back() { return m_Buffers[m_Back]; }
+
+    // Writer side: hand Back() over and start on a fresh one.
+    void Publish() {
+        int previous = m_Middle.exchange(m_Back | FRESH, std::memory_order_acq_rel);
+        m_Back = previous & INDEX_MASK;
+    }
+
+    // Reader side: returns true (and updates Front()) if something new was published.
+    bool Acquire() {
+        if (!(m_Middle.load(std::memory_order_acquire) & FRESH)) {
+            return false;
+        }
+        int previous = m_Middle.exchange(m_Front, std::memory_order_acq_rel);
+        m_Front = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& Front() const { return m_Buffers[m_Front]; }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;
+
+    T m_Buffers[3];
+    int m_Back = 0;
+    alignas(64) std::atomic<int> m_Middle{ 1 };
+    alignas(64) int m_Front = 2;
+};
+
+struct PublishedFrame {
+    DisplayPlane display;
+    DisplayPlane secondPlane;
+    uint64_t frame = 0;
+
+    // Bumped every time a row changes. The reader may skip frames, so rather than
+    // trusting any one frame's dirty rows it uploads the rows whose version moved.
+    uint32_t rowVersions[DISPLAY_MAX_HEIGHT] = {};
+};
+
+// Things the UI can ask for. They run on the emulation thread between frames.
+enum EmulatorCommand : BYTE {
+    COMMAND_QUICK_SAVE,
+    COMMAND_QUICK_LOAD,
+    COMMAND_REWIND,
+    COMMAND_DUMP_PROFILE,
+    COMMAND_TOGGLE_TURBO,
+};
+
+class EmulationThread {
+public:
+    // The machine must already be reset. From Start() until Stop() it belongs to the
+    // emulation thread, and nothing else may touch it.
+    EmulationThread(Chip8& machine, FrameScheduler& scheduler, InputQueue& input);
+    ~EmulationThread();
+    EmulationThread(const EmulationThread&) = delete;
+    EmulationThread& operator=(const EmulationThread&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Record every frame into recorder, which must already have been Begin()'d. Only
+    // before Start(); read the movie back after Stop(). Quick loads and rewinds are
+    // refused while recording, since a movie can only go forwards.
+    void Record(MovieRecorder* recorder) { m_Recorder = recorder; }
+
+    // Run frames under the debug server whenever a client is attached (see Debugger.h),
+    // and write the machine's state out to export after every frame (see StateExport.h).
+    // Either may be null. Only before Start(); both must outlive Stop().
+    void Debug(DebugServer* server);
+    void Export(StateExport* exporter) { m_Export = exporter; }
+
+    // Turbo (COMMAND_TOGGLE_TURBO) runs speed times faster than real time. Only before Start().
+    void SetTurboSpeed(int speed) { m_TurboSpeed = speed > 1 ? speed : 2; }
+
+    // Hand over at most every skip'th frame; changes in the frames between are carried
+    // into the next one handed over. Under turbo this is multiplied by the turbo speed,
+    // so the main thread still sees about 60 frames a second. Only before Start().
+    void SetFrameSkip(int skip) { m_FrameSkip = skip > 0 ? skip : 1; }
+
+    // Returns false if too many commands are already waiting.
+    bool Post(EmulatorCommand command);
+
+    // While the machine waits on FX0A with its timers run down, the emulation thread
+    // sleeps until woken. Call after pushing key events to the input queue.
+    void Wake();
+
+    // Render side. AcquireFrame() returns true when there's a newer frame to show in Frame().
+    bool AcquireFrame() { return m_Frames.Acquire(); }
+    const PublishedFrame& Frame() const { return m_Frames.Front(); }
+
+    // Whether the sound timer was running as of the last frame. Safe to read from any thread.
+    bool IsSoundActive() const { return m_SoundActive.load(std::memory_order_relaxed); }
+    const std::atomic<bool>& SoundGate() const { return m_SoundActive; }
+
+    // Running totals for the speed readout, and the speed the machine is running at
+    // (1, or the turbo speed). Safe to read from any thread. Instructions an idle loop
+    // skip jumped over aren't counted.
+    uint64_t InstructionCount() const { return m_InstructionCount.load(std::memory_order_relaxed); }
+    uint64_t FrameCount() const { return m_FrameCount.load(std::memory_order_relaxed); }
+    int Speed() const { return m_Speed.load(std::memory_order_relaxed); }
+
+private:
+    void Loop();
+    void RunCommand(EmulatorCommand command);
+
+    // Sleep until Wake() is called, or return right away if it was since the frame began.
+    void Park();
+
+    Chip8& m_Machine;
+    FrameScheduler& m_Scheduler;
+    InputQueue& m_Input;
+
+    SPSCQueue<EmulatorCommand, 16> m_Commands;
+    TripleBuffer<PublishedFrame> m_Frames;
+    std::atomic<bool> m_SoundActive{ false };
+    uint32_t m_RowVersions[DISPLAY_MAX_HEIGHT] = {};
+
+    // Frame skipping: whether a skipped frame left changes the main thread hasn't seen
+    int m_FrameSkip = 1;
+    bool m_FramePending = false;
+
+    int m_TurboSpeed = 8;
+    std::atomic<int> m_Speed{ 1 };
+    std::atomic<uint64_t> m_InstructionCount{ 0 };
+    std::atomic<uint64_t> m_FrameCount{ 0 };
+
+    std::mutex m_WakeMutex;
+    std::condition_variable m_Wake;
+    bool m_WakePending = false;
+
+    std::atomic<bool> m_Stopping{ false };
+    std::thread m_Thread;
+
+    // Save states: F5 saves, F9 loads, Backspace rewinds about half a second.
+    MachineSnapshot m_QuickSave;
+    bool m_HasQuickSave = false;
+    RewindBuffer m_Rewind;
+
+    bool m_ReportedFault = false;
+
+    MovieRecorder* m_Recorder = nullptr;
+    DebugServer* m_Debugger = nullptr;
+    StateExport* m_Export = nullptr;
+};
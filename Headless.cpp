@@ -0,0 +1,321 @@
+#include "Headless.h"
+#include "Scheduler.h"
+#include "Analyzer.h"
+#include "Movie.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+static void PrintHeadlessUsage() {
+    printf("Usage: CHIP-8-headless <rom.ch8> [options]\n");
+    printf("  --cycles N      stop after N instructions\n");
+    printf("  --frames N      stop after N 60 Hz frames (default 600, 0 = no limit)\n");
+    printf("  --ips N         instructions per second of emulated time (default 700)\n");
+    printf("  --input FILE    replay key presses from an input script\n");
+    printf("  --movie FILE    play back an input movie and check its screen hashes\n");
+    printf("  --record FILE   save the run as an input movie\n");
+    printf("  --seed N        seed for CXNN's random numbers (decimal, or hex with 0x)\n");
+    printf("  --dispatch M    switch, table, threaded or jit\n");
+    printf("  --quirks P      legacy, vip, chip48, schip or xochip (default: look the ROM up in the quirk database)\n");
+    printf("  --quirk-db FILE quirk database to look ROMs up in (default %s)\n", DEFAULT_QUIRK_DATABASE);
+    printf("  --no-display    don't dump the screen at the end\n");
+    printf("  --no-idle-skip  run idle loops instruction by instruction instead of skipping them\n");
+    printf("  --dump-cfg      print the ROM's control-flow graph and disassembly, then exit\n");
+}
+
+bool ParseHeadlessArgs(int argc, char* argv[], HeadlessOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless") {
+            continue;
+        }
+        else if (arg == "--cycles" && hasValue) {
+            options.instructionBudget = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--frames" && hasValue) {
+            options.frameBudget = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--ips" && hasValue) {
+            options.instructionsPerSecond = atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--input" && hasValue) {
+            options.inputScript = argv[++i];
+        }
+        else if (arg == "--movie" && hasValue) {
+            options.moviePath = argv[++i];
+        }
+        else if (arg == "--record" && hasValue) {
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--dispatch" && hasValue) {
+            if (!ParseDispatchMode(argv[++i], options.dispatch)) {
+                printf("Unknown dispatch mode %s. Use switch, table, threaded or jit.\n", argv[i]);
+                return false;
+            }
+        }
+        else if (arg == "--quirks" && hasValue) {
+            if (!ParseQuirkProfile(argv[++i], options.quirks)) {
+                printf("Unknown quirk profile %s. Use legacy, vip, chip48, schip or xochip.\n", argv[i]);
+                return false;
+            }
+            options.quirksGiven = true;
+        }
+        else if (arg == "--quirk-db" && hasValue) {
+            options.quirkDatabase = argv[++i];
+        }
+        else if (arg == "--no-display") {
+            options.dumpDisplay = false;
+        }
+        else if (arg == "--no-idle-skip") {
+            options.skipIdleLoops = false;
+        }
+        else if (arg == "--dump-cfg") {
+            options.dumpCFG = true;
+        }
+        else if (arg[0] != '-' && options.romPath.empty()) {
+            options.romPath = arg;
+        }
+        else {
+            printf("Unknown option %s\n", arg.c_str());
+            PrintHeadlessUsage();
+            return false;
+        }
+    }
+
+    if (options.romPath.empty()) {
+        PrintHeadlessUsage();
+        return false;
+    }
+    if (!options.moviePath.empty() && !options.inputScript.empty()) {
+        printf("--movie and --input both supply the key presses; pick one.\n");
+        return false;
+    }
+    if (!options.recordPath.empty() && options.instructionBudget != 0) {
+        printf("Movies are made of whole frames: use --frames rather than --cycles with --record.\n");
+        return false;
+    }
+    if (options.moviePath.empty() && options.instructionBudget == 0 && options.frameBudget == 0) {
+        printf("Refusing to run forever: give --cycles or --frames.\n");
+        return false;
+    }
+    return true;
+}
+
+bool LoadInputScript(const std::string& fname, std::vector<InputEvent>& events) {
+    std::ifstream script(fname);
+    if (!script) {
+        printf("Unable to open input script %s\n", fname.c_str());
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(script, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        uint64_t frame;
+        std::string key;
+        int pressed;
+        if (!(fields >> frame)) {
+            continue;
+        }
+        if (!(fields >> key >> pressed)) {
+            printf("%s:%d: expected <frame> <key> <0|1>\n", fname.c_str(), lineNumber);
+            return false;
+        }
+
+        InputEvent event;
+        event.frame = frame;
+        event.key = (BYTE)(strtoul(key.c_str(), nullptr, 16) & 0xF);
+        event.pressed = pressed ? 1 : 0;
+        events.push_back(event);
+    }
+
+    // Apply events in frame order no matter how the script was written.
+    std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b) {
+        return a.frame < b.frame;
+    });
+    return true;
+}
+
+// '#' is lit on the first plane, '+' on XO-CHIP's second plane only, '@' on both.
+static void DumpDisplay(const DisplayPlane& display, const DisplayPlane& secondPlane) {
+    static const char pixels[] = ".#+@";
+    std::string row(display.width + 1, '\n');
+    for (int y = 0; y < display.height; y++) {
+        for (int x = 0; x < display.width; x++) {
+            row[x] = pixels[display.GetPixel(x, y) | (secondPlane.GetPixel(x, y) << 1)];
+        }
+        fwrite(row.data(), 1, row.size(), stdout);
+    }
+}
+
+int RunHeadless(const HeadlessOptions& options) {
+    const ROMImage* rom = LoadCH8ROM(options.romPath.c_str());
+    if (!rom) {
+        return 1;
+    }
+
+    if (options.dumpCFG) {
+        DumpROMAnalysis(stdout, *rom, *GetROMAnalysis(*rom));
+        return 0;
+    }
+
+    std::vector<InputEvent> events;
+    if (!options.inputScript.empty() && !LoadInputScript(options.inputScript, events)) {
+        return 1;
+    }
+
+    // A movie decides how the machine is set up and how long it runs.
+    Movie movie;
+    std::unique_ptr<MoviePlayer> player;
+    int instructionsPerSecond = options.instructionsPerSecond;
+    uint64_t frameBudget = options.frameBudget;
+    if (!options.moviePath.empty()) {
+        if (!LoadMovie(options.moviePath, movie)) {
+            return 1;
+        }
+        if (movie.romHash != rom->hash) {
+            printf("Movie %s was recorded with ROM %016" PRIx64 ", not %016" PRIx64 "\n",
+                options.moviePath.c_str(), movie.romHash, rom->hash);
+            return 1;
+        }
+        player.reset(new MoviePlayer(movie));
+        instructionsPerSecond = movie.instructionsPerSecond;
+        frameBudget = movie.frames;
+    }
+
+    std::unique_ptr<Chip8> machine(new Chip8());
+    machine->m_DispatchMode = options.dispatch;
+    machine->m_SkipIdleLoops = options.skipIdleLoops;
+    if (player) {
+        player->Configure(*machine);
+    }
+    else {
+        machine->m_RandomSeed = options.seed;
+        machine->m_Quirks = options.quirksGiven ? options.quirks : ChooseQuirkProfile(options.quirkDatabase, rom->hash);
+    }
+    if (!ROMFitsQuirkProfile(*rom, machine->m_Quirks)) {
+        return 1;
+    }
+    machine->CPUReset(*rom);
+
+    std::unique_ptr<MovieRecorder> recorder;
+    if (!options.recordPath.empty()) {
+        recorder.reset(new MovieRecorder());
+        recorder->Begin(*machine, rom->hash, instructionsPerSecond);
+    }
+
+    // Same frame structure as the windowed build, minus the waiting.
+    FrameScheduler scheduler;
+    scheduler.Configure(instructionsPerSecond, true);
+    scheduler.Start();
+
+    uint64_t instructions = 0;
+    uint64_t frame = 0;
+    size_t nextEvent = 0;
+    bool desynced = false;
+
+    auto start = std::chrono::steady_clock::now();
+    while (machine->m_Fault == FAULT_NONE &&
+           (frameBudget == 0 || frame < frameBudget) &&
+           (options.instructionBudget == 0 || instructions < options.instructionBudget)) {
+
+        // Key changes land at the start of their frame
+        if (player) {
+            player->BeginFrame(frame, *machine);
+        }
+        for (; nextEvent < events.size() && events[nextEvent].frame <= frame; nextEvent++) {
+            machine->m_Keyboard[events[nextEvent].key] = events[nextEvent].pressed;
+        }
+        if (recorder) {
+            recorder->BeginFrame(*machine);
+        }
+
+        uint64_t count = (uint64_t)scheduler.InstructionsThisFrame();
+        if (options.instructionBudget != 0) {
+            count = std::min(count, options.instructionBudget - instructions);
+        }
+
+        instructions += machine->RunInstructions((int)count);
+        machine->TickTimers();
+        frame++;
+
+        if (recorder) {
+            recorder->EndFrame(*machine);
+        }
+        if (player && !player->EndFrame(frame, *machine)) {
+            desynced = true;
+            break;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    // A fault ends the run early. The recording still gets its checkpoint on the last
+    // frame, and a playback that stopped short of checkpoints it never reached didn't match.
+    if (recorder) {
+        recorder->Finish(*machine);
+    }
+    if (player && !desynced && player->CheckpointsChecked() < movie.checkpoints.size()) {
+        desynced = true;
+    }
+
+    printf("rom=%s\n", options.romPath.c_str());
+    printf("rom_hash=%016" PRIx64 "\n", rom->hash);
+    printf("dispatch=%s\n", DispatchModeName(options.dispatch));
+    printf("quirks=%s\n", QuirkProfileName(machine->m_Quirks));
+    printf("seed=%" PRIu64 "\n", machine->m_RandomSeed);
+    printf("frames=%" PRIu64 "\n", frame);
+    printf("instructions=%" PRIu64 "\n", instructions);
+    printf("seconds=%.6f\n", seconds);
+
+    // The rate only counts what was executed, not what an idle loop skip jumped over.
+    uint64_t executed = instructions - machine->m_SkippedInstructions;
+    printf("executed=%" PRIu64 "\n", executed);
+    printf("ips=%.0f\n", seconds > 0.0 ? executed / seconds : 0.0);
+    printf("idle_skipped=%" PRIu64 "\n", machine->m_SkippedInstructions);
+    printf("pc=%03X\n", machine->m_PC);
+    if (machine->m_Fault != FAULT_NONE) {
+        printf("fault=%s at %03X\n", MachineFaultName(machine->m_Fault), machine->m_FaultPC);
+    }
+    if (player) {
+        printf("movie=%s\n", options.moviePath.c_str());
+        printf("movie_checkpoints=%zu/%zu\n", player->CheckpointsChecked(), movie.checkpoints.size());
+        if (desynced) {
+            printf("movie_result=desync at frame %" PRIu64 "\n", frame);
+        }
+        else {
+            printf("movie_result=ok\n");
+        }
+    }
+    printf("display_hash=%016" PRIx64 "\n", machine->HashDisplay());
+    printf("state_hash=%016" PRIx64 "\n", machine->HashState());
+
+    if (MachineProfiler::enabled) {
+        machine->DumpProfile(stdout);
+    }
+
+    if (options.dumpDisplay) {
+        printf("display=\n");
+        DumpDisplay(machine->m_Display, machine->m_SecondPlane);
+    }
+
+    if (recorder && !SaveMovie(options.recordPath, recorder->GetMovie())) {
+        return 1;
+    }
+    return desynced ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Headless mode
+// Runs the core with no video, audio or input devices: ROM path, instruction/frame
+// budget and an optional input script come in on the command line, and the final
+// state hashes, instruction counts and a text dump of the screen go to stdout.
+//
+// Input scripts are plain text, one key change per line:
+//   <frame> <key, hex 0-F> <1 = down, 0 = up>
+// Blank lines and anything after a '#' are ignored.
+//
+// --record writes the run out as an input movie, and --movie plays one back instead of
+// an input script, checking the screen at every checkpoint (see Movie.h). A movie
+// brings its own seed, quirk profile, speed and length, and the run exits with 1 as
+// soon as the screen stops matching.
+
+#include "Chip8.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct InputEvent {
+    uint64_t frame;
+    BYTE key;
+    BYTE pressed;
+};
+
+struct HeadlessOptions {
+    std::string romPath;
+    std::string inputScript;
+    std::string moviePath;
+    std::string recordPath;
+
+    // Stop after this many instructions or frames, whichever comes first. 0 means no limit.
+    uint64_t instructionBudget = 0;
+    uint64_t frameBudget = 600;
+
+    int instructionsPerSecond = 700;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+    DispatchMode dispatch = DefaultDispatchMode();
+
+    // Without --quirks the profile comes from the quirk database (see Quirks.h)
+    bool quirksGiven = false;
+    QuirkProfile quirks = QUIRKS_LEGACY;
+    std::string quirkDatabase = DEFAULT_QUIRK_DATABASE;
+    bool dumpDisplay = true;
+
+    // Fast-forward through idle loops (see Chip8::m_SkipIdleLoops)
+    bool skipIdleLoops = !MachineProfiler::enabled;
+
+    // Print the ROM's control-flow graph and disassembly instead of running it
+    bool dumpCFG = false;
+};
+
+// Parse the headless flags out of argv. Prints usage and returns false on bad arguments.
+bool ParseHeadlessArgs(int argc, char* argv[], HeadlessOptions& options);
+
+bool LoadInputScript(const std::string& fname, std::vector<InputEvent>& events);
+
+// Run a machine as described by options and print the report. Returns the process exit code.
+int RunHeadless(const HeadlessOptions& options);
@@ -0,0 +1,12 @@
+// CHIP-8 Interpreter, headless build
+// Same core as the windowed build, without linking SDL at all. See Headless.h.
+
+#include "Headless.h"
+
+int main(int argc, char* argv[]) {
+    HeadlessOptions options;
+    if (!ParseHeadlessArgs(argc, argv, options)) {
+        return 1;
+    }
+    return RunHeadless(options);
+}
@@ -0,0 +1,58 @@
+#include "Input.h"
+#include "Chip8.h"
+
+bool KeyMap::Bind(int32_t keycode, BYTE key) {
+    if (key > 0xF) {
+        return false;
+    }
+
+    for (int i = 0; i < m_Count; i++) {
+        if (m_Bindings[i].keycode == keycode) {
+            m_Bindings[i].key = key;
+            return true;
+        }
+    }
+
+    if (m_Count == MAX_BINDINGS) {
+        return false;
+    }
+    m_Bindings[m_Count++] = { keycode, key };
+    return true;
+}
+
+void KeyMap::Unbind(int32_t keycode) {
+    for (int i = 0; i < m_Count; i++) {
+        if (m_Bindings[i].keycode == keycode) {
+            m_Bindings[i] = m_Bindings[--m_Count];
+            return;
+        }
+    }
+}
+
+int KeyMap::Find(int32_t keycode) const {
+    for (int i = 0; i < m_Count; i++) {
+        if (m_Bindings[i].keycode == keycode) {
+            return m_Bindings[i].key;
+        }
+    }
+    return -1;
+}
+
+int ApplyKeyEvents(InputQueue& queue, Chip8& machine) {
+    int applied = 0;
+    uint32_t changed = 0;
+    KeyEvent event;
+    while (queue.Peek(event)) {
+        int key = event.key & 0xF;
+        if (changed & (1u << key)) {
+            break;
+        }
+        if (machine.m_Keyboard[key] != event.pressed) {
+            machine.m_Keyboard[key] = event.pressed;
+            changed |= 1u << key;
+        }
+        queue.Pop(event);
+        applied++;
+    }
+    return applied;
+}
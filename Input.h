@@ -0,0 +1,111 @@
+#pragma once
+
+// Input
+// The frontend turns host key presses into KeyEvents and pushes them onto an InputQueue;
+// whoever drives the machine pops them off at the start of each frame. The queue is a
+// single-producer/single-consumer ring, so polling and emulating can happen on different
+// threads without either one ever taking a lock.
+//
+// Which host key maps to which CHIP-8 key lives in a KeyMap, so it can be rebound at
+// run time instead of being baked into a switch.
+
+#include "Types.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class Chip8;
+
+// Events are applied in the order they were pushed, at frame boundaries (see
+// ApplyKeyEvents), so when exactly the host saw them doesn't matter.
+struct KeyEvent {
+    BYTE key;               // 0x0 - 0xF
+    BYTE pressed;           // 1 = down, 0 = up
+};
+
+// Fixed-capacity ring for exactly one producer thread and one consumer thread.
+// Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // Returns false (and drops the item) if the queue is full.
+    bool Push(const T& item) {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head - m_Tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_Items[head & (Capacity - 1)] = item;
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Look at the next item without taking it. Consumer only.
+    bool Peek(T& item) const {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail == m_Head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_Items[tail & (Capacity - 1)];
+        return true;
+    }
+
+    bool Pop(T& item) {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail == m_Head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_Items[tail & (Capacity - 1)];
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const {
+        return m_Tail.load(std::memory_order_acquire) == m_Head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> m_Items;
+
+    // Kept on separate cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> m_Head{ 0 };
+    alignas(64) std::atomic<size_t> m_Tail{ 0 };
+};
+
+// A couple of seconds of frantic mashing. Nobody types 256 keys in one frame.
+typedef SPSCQueue<KeyEvent, 256> InputQueue;
+
+// Host keycode -> CHIP-8 key. Keycodes are whatever the frontend uses (SDL_Keycode for
+// the windowed build); the core never looks inside them.
+class KeyMap {
+public:
+    static const int MAX_BINDINGS = 64;
+
+    // Several host keys may share one CHIP-8 key. Rebinding a host key replaces its old binding.
+    bool Bind(int32_t keycode, BYTE key);
+    void Unbind(int32_t keycode);
+    void Clear() { m_Count = 0; }
+
+    // Returns -1 if the host key isn't bound to anything.
+    int Find(int32_t keycode) const;
+
+    int Count() const { return m_Count; }
+
+private:
+    struct Binding {
+        int32_t keycode;
+        BYTE key;
+    };
+
+    // Only a handful of bindings, so a flat array beats any hash table.
+    Binding m_Bindings[MAX_BINDINGS];
+    int m_Count = 0;
+};
+
+// Apply queued events to the machine's keypad, in order, stopping before the second
+// change to any one key. That change and everything after it wait for the next frame,
+// so a tap shorter than a frame is still down for one frame and up for the next, and
+// FX0A and EX9E get to see both edges. Returns how many were applied.
+int ApplyKeyEvents(InputQueue& queue, Chip8& machine);
@@ -0,0 +1,381 @@
+#include "JIT.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+// Longest block we'll build, in instructions
+const int MAX_BLOCK_LENGTH = 64;
+const int MAX_BLOCK_BYTES = MAX_BLOCK_LENGTH * 2;
+
+// Code space per machine. A block is at most a couple of KB, and most ROMs only have
+// a few dozen of them.
+const size_t CODE_ARENA_SIZE = 256 * 1024;
+
+typedef void (*NativeBlock)();
+
+struct JITBlock {
+    WORD startPC;
+    WORD endPC;
+
+    // Number of instructions, terminator included
+    int length;
+
+    // Whether the last instruction is a jump/skip/call/return, which needs m_PC to be up to date
+    bool hasTerminator;
+
+    // The native code points straight into this, so it must not change after compiling.
+    std::vector<Instruction> instructions;
+
+    NativeBlock native;
+};
+
+// Opcodes that end a block. Everything that changes the PC, plus the memory writers
+// so a block never keeps running over code it might have just overwritten.
+static bool EndsBlock(BYTE kind) {
+    switch (kind) {
+        case OP_00EE: case OP_1NNN: case OP_2NNN: case OP_3XNN: case OP_4XNN:
+        case OP_5XY0: case OP_9XY0: case OP_BNNN: case OP_EX9E: case OP_EXA1:
+        case OP_00FD: case OP_F000: case OP_FX0A:
+        case OP_FX33: case OP_FX55: case OP_5XY2:
+            return true;
+    }
+    return false;
+}
+
+// F000 reads its operand from the PC, and 00FD and FX0A park the machine on themselves.
+static bool NeedsPC(BYTE kind) {
+    return EndsBlock(kind) && kind != OP_FX33 && kind != OP_FX55 && kind != OP_5XY2;
+}
+
+#ifdef CHIP8_JIT_X64
+
+static BYTE* AllocateCodeArena(size_t size) {
+#ifdef _WIN32
+    return static_cast<BYTE*>(VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? nullptr : static_cast<BYTE*>(memory);
+#endif
+}
+
+static void FreeCodeArena(BYTE* arena, size_t size) {
+#ifdef _WIN32
+    VirtualFree(arena, 0, MEM_RELEASE);
+#else
+    munmap(arena, size);
+#endif
+}
+
+// A tiny x86-64 assembler, just enough for calling handlers and poking registers.
+class Emitter {
+public:
+    std::vector<BYTE> code;
+
+    void Byte(BYTE b) { code.push_back(b); }
+    void Bytes(std::initializer_list<BYTE> bytes) { code.insert(code.end(), bytes); }
+    void Imm16(WORD value) { Byte(value & 0xFF); Byte(value >> 8); }
+    void Imm64(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            Byte((value >> (i * 8)) & 0xFF);
+        }
+    }
+
+    // movabs rax, imm64
+    void MovRaxImm(const void* ptr) { Bytes({ 0x48, 0xB8 }); Imm64((uint64_t)(uintptr_t)ptr); }
+
+    // movabs rdi/rcx, imm64 - whichever carries the first argument
+    void MovArg0Imm(const void* ptr) {
+#ifdef _WIN32
+        Bytes({ 0x48, 0xB9 });
+#else
+        Bytes({ 0x48, 0xBF });
+#endif
+        Imm64((uint64_t)(uintptr_t)ptr);
+    }
+
+    // movabs rsi/rdx, imm64 - the second argument
+    void MovArg1Imm(const void* ptr) {
+#ifdef _WIN32
+        Bytes({ 0x48, 0xBA });
+#else
+        Bytes({ 0x48, 0xBE });
+#endif
+        Imm64((uint64_t)(uintptr_t)ptr);
+    }
+
+    // handler(machine, ins)
+    void CallHandler(Chip8::OpcodeHandler handler, Chip8* machine, const Instruction* ins) {
+        MovArg0Imm(machine);
+        MovArg1Imm(ins);
+        MovRaxImm((const void*)handler);
+        Bytes({ 0xFF, 0xD0 });                        // call rax
+    }
+
+    void StoreWord(WORD* target, WORD value) {
+        MovRaxImm(target);
+        Bytes({ 0x66, 0xC7, 0x00 });                  // mov word [rax], imm16
+        Imm16(value);
+    }
+
+    void Prologue() {
+        Byte(0x53);                                   // push rbx (keeps the stack 16-byte aligned)
+#ifdef _WIN32
+        Bytes({ 0x48, 0x83, 0xEC, 0x20 });            // sub rsp, 32 (shadow space)
+#endif
+    }
+
+    void Epilogue() {
+#ifdef _WIN32
+        Bytes({ 0x48, 0x83, 0xC4, 0x20 });            // add rsp, 32
+#endif
+        Byte(0x5B);                                   // pop rbx
+        Byte(0xC3);                                   // ret
+    }
+};
+
+// Emit one instruction. The simplest register ops are done inline; the rest call their handler.
+static void EmitInstruction(Emitter& e, Chip8& m, const Instruction* ins) {
+    switch (ins->kind) {
+        case OP_6XNN:
+            e.MovRaxImm(&m.m_Registers[ins->x]);
+            e.Bytes({ 0xC6, 0x00, ins->nn });         // mov byte [rax], nn
+            break;
+        case OP_7XNN:
+            e.MovRaxImm(&m.m_Registers[ins->x]);
+            e.Bytes({ 0x80, 0x00, ins->nn });         // add byte [rax], nn
+            break;
+        case OP_8XY0:
+            e.MovRaxImm(&m.m_Registers[ins->y]);
+            e.Bytes({ 0x8A, 0x08 });                  // mov cl, [rax]
+            e.MovRaxImm(&m.m_Registers[ins->x]);
+            e.Bytes({ 0x88, 0x08 });                  // mov [rax], cl
+            break;
+        case OP_ANNN:
+            e.StoreWord(&m.m_AddressI, ins->nnn);
+            break;
+        case OP_1NNN:
+            e.StoreWord(&m.m_PC, ins->nnn);
+            break;
+        default:
+            e.CallHandler(m.Handlers()[ins->kind], &m, ins);
+            break;
+    }
+}
+
+// Returns nullptr if the block doesn't fit in what's left of the arena.
+static NativeBlock CompileNative(Chip8& m, const JITBlock& block, BYTE* arena, size_t& used) {
+    Emitter e;
+    e.Prologue();
+
+    int bodyLength = block.hasTerminator ? block.length - 1 : block.length;
+    for (int i = 0; i < bodyLength; i++) {
+        EmitInstruction(e, m, &block.instructions[i]);
+    }
+
+    // The terminator sees m_PC pointing just past itself, same as in the interpreter.
+    e.StoreWord(&m.m_PC, block.endPC);
+    if (block.hasTerminator) {
+        EmitInstruction(e, m, &block.instructions[bodyLength]);
+    }
+
+    e.Epilogue();
+
+    if (used + e.code.size() > CODE_ARENA_SIZE) {
+        return nullptr;
+    }
+
+    BYTE* target = arena + used;
+    memcpy(target, e.code.data(), e.code.size());
+
+    // Keep every block 16-byte aligned
+    used += (e.code.size() + 15) & ~(size_t)15;
+    return reinterpret_cast<NativeBlock>(target);
+}
+
+#endif
+
+bool IsNativeJITAvailable() {
+#ifdef CHIP8_JIT_X64
+    static const bool available = [] {
+        BYTE* probe = AllocateCodeArena(4096);
+        if (!probe) {
+            return false;
+        }
+        FreeCodeArena(probe, 4096);
+        return true;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+JITCache::JITCache(Chip8& machine) : m_Machine(machine) {
+#ifdef CHIP8_JIT_X64
+    if (IsNativeJITAvailable()) {
+        m_CodeArena = AllocateCodeArena(CODE_ARENA_SIZE);
+    }
+#endif
+}
+
+JITCache::~JITCache() {
+#ifdef CHIP8_JIT_X64
+    if (m_CodeArena) {
+        FreeCodeArena(m_CodeArena, CODE_ARENA_SIZE);
+    }
+#endif
+}
+
+void JITCache::MarkCodePages(int start, int end) {
+    for (int page = start >> JIT_PAGE_SHIFT; page <= ((end - 1) >> JIT_PAGE_SHIFT); page++) {
+        m_Machine.m_JITCodePages[page & (JIT_PAGE_COUNT - 1)] = 1;
+    }
+}
+
+JITBlock* JITCache::CompileBlock(WORD startPC) {
+    const std::array<BYTE, MEMORY_SIZE>& memory = m_Machine.m_GameMemory;
+    const Instruction* table = GetDecodeTable();
+    std::unique_ptr<JITBlock> block(new JITBlock());
+    block->startPC = startPC;
+    block->hasTerminator = false;
+    block->native = nullptr;
+    block->instructions.reserve(MAX_BLOCK_LENGTH);
+
+    // Walk forward until something changes the PC, or we run out of room.
+    int pc = startPC;
+    while ((int)block->instructions.size() < MAX_BLOCK_LENGTH && pc + 1 < (int)CODE_ADDRESS_LIMIT) {
+        WORD opcode = (memory[pc] << 8) | memory[pc + 1];
+        const Instruction& ins = table[opcode];
+        block->instructions.push_back(ins);
+        pc += 2;
+
+        if (EndsBlock(ins.kind)) {
+            block->hasTerminator = NeedsPC(ins.kind);
+            break;
+        }
+    }
+
+    block->endPC = (WORD)pc;
+    block->length = (int)block->instructions.size();
+    if (block->length == 0) {
+        return nullptr;
+    }
+
+#ifdef CHIP8_JIT_X64
+    if (m_CodeArena) {
+        block->native = CompileNative(m_Machine, *block, m_CodeArena, m_CodeUsed);
+
+        // Out of code space: start over with an empty cache. Nothing is running right now.
+        if (!block->native) {
+            Flush();
+            block->native = CompileNative(m_Machine, *block, m_CodeArena, m_CodeUsed);
+        }
+    }
+#endif
+
+    MarkCodePages(block->startPC, block->endPC);
+    m_BlockCache[startPC] = std::move(block);
+    return m_BlockCache[startPC].get();
+}
+
+// Fallback for when there's no native code: run the block from its instruction list.
+void JITCache::ExecuteBlock(const JITBlock& block) {
+    Chip8& m = m_Machine;
+    if (block.native) {
+        block.native();
+        return;
+    }
+
+    int bodyLength = block.hasTerminator ? block.length - 1 : block.length;
+    for (int i = 0; i < bodyLength; i++) {
+        const Instruction& ins = block.instructions[i];
+        m.Handlers()[ins.kind](m, ins);
+    }
+
+    m.m_PC = block.endPC;
+    if (block.hasTerminator) {
+        const Instruction& ins = block.instructions[bodyLength];
+        m.Handlers()[ins.kind](m, ins);
+    }
+}
+
+void JITCache::Run(int count) {
+    const Instruction* table = GetDecodeTable();
+    Chip8& m = m_Machine;
+
+    // Native blocks call the handlers of the profile they were compiled under.
+    if (m.m_Quirks != m_CompiledQuirks) {
+        Flush();
+        m_CompiledQuirks = m.m_Quirks;
+    }
+
+    while (count > 0) {
+        int pc = m.m_PC;
+        JITBlock* block = nullptr;
+        if (pc + 1 < (int)CODE_ADDRESS_LIMIT) {
+            block = m_BlockCache[pc] ? m_BlockCache[pc].get() : CompileBlock((WORD)pc);
+        }
+
+        // The interpreter takes over for anything the cache can't do, and for the tail
+        // of the budget when the next block is longer than what's left.
+        if (!block || block->length > count) {
+            int steps = block ? count : 1;
+            for (int i = 0; i < steps; i++) {
+                const Instruction& ins = table[m.GetNextOpcode()];
+                m.Handlers()[ins.kind](m, ins);
+            }
+            count -= steps;
+            continue;
+        }
+
+        ExecuteBlock(*block);
+        count -= block->length;
+
+        // Blocks are straight-line code, so every instruction in one has run.
+        if (MachineProfiler::enabled) {
+            for (int i = 0; i < block->length; i++) {
+                m.m_Profiler.Instruction(block->startPC + i * 2, block->instructions[i].kind);
+            }
+        }
+
+        if (!m_Retired.empty()) {
+            m_Retired.clear();
+        }
+    }
+}
+
+void JITCache::Flush() {
+    for (auto& block : m_BlockCache) {
+        if (block) {
+            m_Retired.push_back(std::move(block));
+        }
+    }
+    m_Machine.m_JITCodePages.fill(0);
+    m_CodeUsed = 0;
+}
+
+void JITCache::Invalidate(int address, int length) {
+    int first = address - MAX_BLOCK_BYTES + 1;
+    if (first < 0) {
+        first = 0;
+    }
+    int last = address + length;
+    if (last > 0x1000) {
+        last = 0x1000;
+    }
+
+    for (int start = first; start < last; start++) {
+        std::unique_ptr<JITBlock>& block = m_BlockCache[start];
+        if (block && block->startPC < address + length && block->endPC > address) {
+            m_Retired.push_back(std::move(block));
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Basic-block dynarec
+// Straight-line runs of instructions are collected into blocks that end at the first
+// jump, skip, call or return. On x86-64 each block is compiled into host code that
+// calls the opcode handlers back to back (simple loads/stores are emitted inline).
+// Everywhere else, or if the OS won't hand out executable memory, blocks are run
+// from their pre-decoded instruction list instead. Either way the results are
+// identical to the interpreter.
+//
+// Every Chip8 gets its own JITCache, and the generated code has the addresses of that
+// machine's registers baked in.
+
+#include "Chip8.h"
+#include <memory>
+#include <vector>
+
+struct JITBlock;
+
+class JITCache {
+public:
+    explicit JITCache(Chip8& machine);
+    ~JITCache();
+    JITCache(const JITCache&) = delete;
+    JITCache& operator=(const JITCache&) = delete;
+
+    // Run exactly count instructions through the block cache.
+    void Run(int count);
+
+    // Drop every compiled block. CPUReset calls this since memory gets replaced.
+    void Flush();
+
+    // Drop every block that was compiled from [address, address + length).
+    void Invalidate(int address, int length);
+
+    // True if blocks are being compiled to host code rather than run from their instruction lists.
+    bool IsNative() const { return m_CodeArena != nullptr; }
+
+private:
+    JITBlock* CompileBlock(WORD startPC);
+    void ExecuteBlock(const JITBlock& block);
+    void MarkCodePages(int start, int end);
+
+    Chip8& m_Machine;
+    QuirkProfile m_CompiledQuirks = QUIRKS_LEGACY;
+
+    std::unique_ptr<JITBlock> m_BlockCache[0x1000];
+
+    // Blocks that got invalidated while one of them might still be running.
+    // They're freed once control is back in Run.
+    std::vector<std::unique_ptr<JITBlock>> m_Retired;
+
+    // Every compiled block lives in here. When it fills up the whole cache is flushed.
+    BYTE* m_CodeArena = nullptr;
+    size_t m_CodeUsed = 0;
+};
+
+// True if this host can run compiled blocks at all.
+bool IsNativeJITAvailable();
@@ -0,0 +1,371 @@
+#include "Lanes.h"
+#include "ALU.h"
+#include <cstring>
+
+// One 8XY* opcode across every lane. When VX, VY and VF are three different registers
+// the columns are worked on as local copies, which the compiler knows can't overlap and
+// so is happy to vectorize. 8XF4 and friends work on the registers themselves, one
+// lane at a time, going through the same helper as the scalar handler does.
+template <int LANES, void (*Op)(BYTE&, BYTE&, BYTE&)>
+static inline void ALUAcrossLanes(BYTE* vx, BYTE* vy, BYTE* vf, bool distinct) {
+    if (!distinct) {
+        for (int lane = 0; lane < LANES; lane++) {
+            Op(vx[lane], vy[lane], vf[lane]);
+        }
+        return;
+    }
+
+    BYTE x[LANES], y[LANES], f[LANES];
+    memcpy(x, vx, LANES);
+    memcpy(y, vy, LANES);
+    memcpy(f, vf, LANES);
+    for (int lane = 0; lane < LANES; lane++) {
+        Op(x[lane], y[lane], f[lane]);
+    }
+    memcpy(vx, x, LANES);
+    memcpy(vy, y, LANES);
+    memcpy(vf, f, LANES);
+}
+
+template <int LANES>
+LaneGroup<LANES>::LaneGroup() {
+    for (auto& machine : m_Machines) {
+        machine.reset(new Chip8());
+    }
+}
+
+template <int LANES>
+void LaneGroup<LANES>::Reset(const ROMImage& rom, QuirkProfile quirks) {
+    m_Quirks = quirks;
+    for (auto& machine : m_Machines) {
+        machine->m_Quirks = quirks;
+        machine->CPUReset(rom);
+    }
+    m_Group = 0;
+    m_GroupSize = 0;
+    m_SharedCode = true;
+    m_RanAlone = 0;
+    m_LockstepInstructions = 0;
+    m_ScalarInstructions = 0;
+}
+
+template <int LANES>
+void LaneGroup<LANES>::RunInstructions(int count) {
+    if (count <= 0) {
+        return;
+    }
+    switch (m_Quirks) {
+#define CHIP8_QUIRK_CASE(id, policy, name) case QUIRKS_##id: RunLockstep<policy>(count); break;
+        CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_CASE)
+#undef CHIP8_QUIRK_CASE
+        default: break;
+    }
+}
+
+template <int LANES>
+void LaneGroup<LANES>::TickTimers() {
+    for (auto& machine : m_Machines) {
+        machine->TickTimers();
+    }
+}
+
+template <int LANES>
+void LaneGroup<LANES>::LoadLane(int lane) {
+    const Chip8& machine = *m_Machines[lane];
+    for (int r = 0; r < 16; r++) {
+        m_Registers[r][lane] = machine.m_Registers[r];
+    }
+    m_AddressI[lane] = machine.m_AddressI;
+    m_DelayTimer[lane] = machine.delayTimer;
+    m_SoundTimer[lane] = machine.soundTimer;
+}
+
+template <int LANES>
+void LaneGroup<LANES>::StoreLane(int lane) {
+    Chip8& machine = *m_Machines[lane];
+    for (int r = 0; r < 16; r++) {
+        machine.m_Registers[r] = m_Registers[r][lane];
+    }
+    machine.m_AddressI = m_AddressI[lane];
+    machine.delayTimer = m_DelayTimer[lane];
+    machine.soundTimer = m_SoundTimer[lane];
+    machine.m_PC = m_PC;
+}
+
+template <int LANES>
+void LaneGroup<LANES>::RunAlone(int lane, int count) {
+    Chip8& machine = *m_Machines[lane];
+    if (machine.m_Fault == FAULT_NONE) {
+        m_ScalarInstructions += machine.RunInstructions(count);
+        m_RanAlone |= 1u << lane;
+    }
+}
+
+template <int LANES>
+void LaneGroup<LANES>::Leave(int lane) {
+    m_Group &= ~(1u << lane);
+    m_GroupSize--;
+}
+
+template <int LANES>
+void LaneGroup<LANES>::SplitOff(int lane, WORD pc, int remaining) {
+    StoreLane(lane);
+    m_Machines[lane]->m_PC = pc;
+    Leave(lane);
+    if (remaining > 0) {
+        RunAlone(lane, remaining);
+    }
+}
+
+template <int LANES>
+bool LaneGroup<LANES>::Regroup(int count) {
+    m_Group = 0;
+    m_GroupSize = 0;
+
+    int best = -1;
+    int bestVotes = 0;
+    for (int a = 0; a < LANES; a++) {
+        if (m_Machines[a]->m_Fault != FAULT_NONE) {
+            continue;
+        }
+        int votes = 0;
+        for (int b = 0; b < LANES; b++) {
+            votes += m_Machines[b]->m_Fault == FAULT_NONE && m_Machines[b]->m_PC == m_Machines[a]->m_PC;
+        }
+        if (votes > bestVotes) {
+            best = a;
+            bestVotes = votes;
+        }
+    }
+
+    // Nobody to keep in step with: everyone just runs alone.
+    if (bestVotes < 2) {
+        for (int lane = 0; lane < LANES; lane++) {
+            RunAlone(lane, count);
+        }
+        return false;
+    }
+
+    m_PC = m_Machines[best]->m_PC;
+    for (int lane = 0; lane < LANES; lane++) {
+        if (m_Machines[lane]->m_Fault != FAULT_NONE) {
+            continue;
+        }
+        if (m_Machines[lane]->m_PC == m_PC) {
+            m_Group |= 1u << lane;
+            m_GroupSize++;
+            LoadLane(lane);
+        }
+        else {
+            RunAlone(lane, count);
+        }
+    }
+
+    if (!m_SharedCode || (m_Group & m_RanAlone)) {
+        const BYTE* code = m_Machines[best]->m_GameMemory.data();
+        m_SharedCode = true;
+        for (int lane = 0; lane < LANES; lane++) {
+            if ((m_Group & (1u << lane)) && memcmp(m_Machines[lane]->m_GameMemory.data(), code, CODE_ADDRESS_LIMIT) != 0) {
+                m_SharedCode = false;
+            }
+        }
+        m_RanAlone &= ~m_Group;
+    }
+    return true;
+}
+
+template <int LANES>
+void LaneGroup<LANES>::Converge(const WORD (&next)[LANES], int remaining) {
+
+    // Boyer-Moore majority vote. If there's no outright majority the survivor is still
+    // a popular choice, which is all that matters here.
+    WORD candidate = 0;
+    int votes = 0;
+    for (int lane = 0; lane < LANES; lane++) {
+        if (m_Group & (1u << lane)) {
+            if (votes == 0) {
+                candidate = next[lane];
+            }
+            votes += next[lane] == candidate ? 1 : -1;
+        }
+    }
+
+    for (int lane = 0; lane < LANES; lane++) {
+        if ((m_Group & (1u << lane)) && next[lane] != candidate) {
+            SplitOff(lane, next[lane], remaining);
+        }
+    }
+    m_PC = candidate;
+}
+
+template <int LANES>
+template <class Quirks>
+void LaneGroup<LANES>::RunLockstep(int count) {
+    if (!Regroup(count)) {
+        return;
+    }
+
+    const Instruction* table = GetDecodeTable();
+    for (int step = 0; step < count && m_GroupSize > 0; step++) {
+        const int remaining = count - step - 1;
+
+        // A lone lane is better off on its own machine's dispatcher.
+        if (m_GroupSize == 1) {
+            for (int lane = 0; lane < LANES; lane++) {
+                if (m_Group & (1u << lane)) {
+                    SplitOff(lane, m_PC, remaining + 1);
+                }
+            }
+            break;
+        }
+
+        // Lanes can only share an instruction if their memory agrees on what it is;
+        // a lane that wrote over its code goes its own way.
+        int first = 0;
+        while (!(m_Group & (1u << first))) {
+            first++;
+        }
+        const BYTE high = m_Machines[first]->m_GameMemory[m_PC];
+        const BYTE low = m_Machines[first]->m_GameMemory[(WORD)(m_PC + 1)];
+        if (!m_SharedCode || m_PC >= CODE_ADDRESS_LIMIT - 1) {
+            for (int lane = first + 1; lane < LANES; lane++) {
+                if ((m_Group & (1u << lane)) &&
+                    (m_Machines[lane]->m_GameMemory[m_PC] != high || m_Machines[lane]->m_GameMemory[(WORD)(m_PC + 1)] != low)) {
+                    SplitOff(lane, m_PC, remaining + 1);
+                }
+            }
+        }
+
+        // A copy, so the compiler doesn't have to assume the register stores below land on it
+        const Instruction ins = table[(high << 8) | low];
+        const bool distinct = ins.x != ins.y && ins.x != 0xF && ins.y != 0xF;
+        BYTE* vx = m_Registers[ins.x];
+        BYTE* vy = m_Registers[ins.y];
+        BYTE* vf = m_Registers[0xF];
+        BYTE skip[LANES];
+        WORD next[LANES];
+        bool branches = false;
+
+        // Lanes that left the group still have columns here. They get computed on
+        // too, which costs nothing and keeps the loops free of masks.
+        switch (ins.kind) {
+            case OP_6XNN:
+                for (int lane = 0; lane < LANES; lane++) {
+                    vx[lane] = ins.nn;
+                }
+                break;
+            case OP_7XNN:
+                for (int lane = 0; lane < LANES; lane++) {
+                    vx[lane] += ins.nn;
+                }
+                break;
+#define CHIP8_LANE_ALU(name) \
+            case OP_##name: \
+                ALUAcrossLanes<LANES, Alu##name<Quirks>>(vx, vy, vf, distinct); \
+                break;
+            CHIP8_LANE_ALU(8XY0) CHIP8_LANE_ALU(8XY1) CHIP8_LANE_ALU(8XY2) CHIP8_LANE_ALU(8XY3)
+            CHIP8_LANE_ALU(8XY4) CHIP8_LANE_ALU(8XY5) CHIP8_LANE_ALU(8XY6) CHIP8_LANE_ALU(8XY7)
+            CHIP8_LANE_ALU(8XYE)
+#undef CHIP8_LANE_ALU
+            case OP_ANNN:
+                for (int lane = 0; lane < LANES; lane++) {
+                    m_AddressI[lane] = ins.nnn;
+                }
+                break;
+            case OP_1NNN:
+                m_PC = ins.nnn;
+                m_LockstepInstructions += m_GroupSize;
+                continue;
+            case OP_3XNN:
+                for (int lane = 0; lane < LANES; lane++) {
+                    skip[lane] = vx[lane] == ins.nn;
+                }
+                branches = true;
+                break;
+            case OP_4XNN:
+                for (int lane = 0; lane < LANES; lane++) {
+                    skip[lane] = vx[lane] != ins.nn;
+                }
+                branches = true;
+                break;
+            case OP_5XY0:
+                for (int lane = 0; lane < LANES; lane++) {
+                    skip[lane] = vx[lane] == vy[lane];
+                }
+                branches = true;
+                break;
+            case OP_9XY0:
+                for (int lane = 0; lane < LANES; lane++) {
+                    skip[lane] = vx[lane] != vy[lane];
+                }
+                branches = true;
+                break;
+
+            // Everything else runs on each lane's own machine with the usual handlers.
+            default:
+                if (ins.kind == OP_FX33 || ins.kind == OP_FX55 || ins.kind == OP_5XY2) {
+                    m_SharedCode = false;
+                }
+
+                // Counted before anyone faults out of the group: the faulting instruction ran too.
+                m_ScalarInstructions += m_GroupSize;
+                for (int lane = 0; lane < LANES; lane++) {
+                    if (!(m_Group & (1u << lane))) {
+                        continue;
+                    }
+                    Chip8& machine = *m_Machines[lane];
+                    StoreLane(lane);
+                    machine.DecodeOpcodeCycle(machine.GetNextOpcode());
+                    LoadLane(lane);
+                    next[lane] = machine.m_PC;
+                    if (machine.m_Fault != FAULT_NONE) {
+                        Leave(lane);
+                    }
+                }
+                Converge(next, remaining);
+                continue;
+        }
+
+        m_LockstepInstructions += m_GroupSize;
+        const WORD fallThrough = (WORD)(m_PC + 2);
+        if (!branches) {
+            m_PC = fallThrough;
+            continue;
+        }
+
+        // Usually every lane goes the same way.
+        int taken = 0;
+        for (int lane = 0; lane < LANES; lane++) {
+            taken += (m_Group >> lane) & skip[lane];
+        }
+        if (!Quirks::longSkips && (taken == 0 || taken == m_GroupSize)) {
+            m_PC = (WORD)(fallThrough + (taken ? 2 : 0));
+            continue;
+        }
+
+        // Where each lane's skip lands. Under XO-CHIP that depends on the lane's own
+        // memory, since skipping an F000 NNNN skips all four bytes.
+        for (int lane = 0; lane < LANES; lane++) {
+            if (!(m_Group & (1u << lane))) {
+                continue;
+            }
+            const BYTE* memory = m_Machines[lane]->m_GameMemory.data();
+            int length = Quirks::longSkips && memory[fallThrough] == 0xF0 && memory[(WORD)(fallThrough + 1)] == 0x00 ? 4 : 2;
+            next[lane] = (WORD)(fallThrough + (skip[lane] ? length : 0));
+        }
+        Converge(next, remaining);
+    }
+
+    // Everyone still in step goes back to their own machine.
+    for (int lane = 0; lane < LANES; lane++) {
+        if (m_Group & (1u << lane)) {
+            StoreLane(lane);
+        }
+    }
+    m_Group = 0;
+    m_GroupSize = 0;
+}
+
+template class LaneGroup<8>;
+template class LaneGroup<16>;
+template class LaneGroup<32>;
@@ -0,0 +1,93 @@
+#pragma once
+
+// Lane interpreter
+// Runs LANES copies of one ROM in lockstep, for fuzzing and the like where the same
+// program runs over and over with different seeds and input. While lanes are on the
+// same instruction their registers, I and timers live lane-wise (V0 of every lane side
+// by side, then V1...), so 6XNN, 7XNN, 8XY0-8XYE, ANNN, 1NNN and the conditional skips
+// run as one short loop across all of them, which the compiler turns into SIMD
+// (SSE2 by default; AVX2 or AVX-512 when built for a CPU that has them). Anything
+// else runs lane by lane on each lane's own Chip8, using the same handlers as always.
+//
+// Lanes part ways when a skip, a key test or a random number sends them to different
+// places. The bigger half stays in lockstep, and the rest are split off to run the
+// remainder of the batch on their own machines. Every RunInstructions() call starts by
+// regrouping the lanes that have come back to the same PC, which games that wait for
+// the next frame in a delay-timer loop do all the time.
+//
+// Each lane runs exactly the instructions a lone Chip8 would have, so per-lane hashes
+// match a plain run with the same seed and input.
+
+#include "Chip8.h"
+#include <cstdint>
+#include <memory>
+
+template <int LANES>
+class LaneGroup {
+    static_assert(LANES == 8 || LANES == 16 || LANES == 32, "lane groups are 8, 16 or 32 wide");
+
+public:
+    LaneGroup();
+    LaneGroup(const LaneGroup&) = delete;
+    LaneGroup& operator=(const LaneGroup&) = delete;
+
+    // Each lane's machine. Set seeds, keys and dispatch mode (used while a lane is split
+    // off) on these directly. Safe to touch between calls, never during one.
+    Chip8& Lane(int lane) { return *m_Machines[lane]; }
+    const Chip8& Lane(int lane) const { return *m_Machines[lane]; }
+
+    // CPUReset() every lane with the same ROM and quirk profile.
+    void Reset(const ROMImage& rom, QuirkProfile quirks);
+
+    // Run count instructions on every lane that hasn't faulted.
+    void RunInstructions(int count);
+    void TickTimers();
+
+    // Instructions run in lockstep, summed over the lanes that ran them, and
+    // instructions run lane by lane, split off or not. Counted the way
+    // Chip8::RunInstructions() counts them, so a lane that faults stops adding up.
+    uint64_t LockstepInstructions() const { return m_LockstepInstructions; }
+    uint64_t ScalarInstructions() const { return m_ScalarInstructions; }
+
+private:
+    template <class Quirks> void RunLockstep(int count);
+
+    // Pick the PC the most lanes are at and load those lanes lane-wise. The rest run
+    // count instructions on their own. Returns false if there's nobody left to group.
+    bool Regroup(int count);
+
+    // Move a lane's registers, I, timers and PC between its machine and the lanes.
+    void LoadLane(int lane);
+    void StoreLane(int lane);
+
+    // Take a lane out of the group with its PC at pc, and run the rest of its batch alone.
+    void SplitOff(int lane, WORD pc, int remaining);
+
+    // Everyone in the group whose next PC isn't the one most of them agree on splits off.
+    void Converge(const WORD (&next)[LANES], int remaining);
+
+    void RunAlone(int lane, int count);
+    void Leave(int lane);
+
+    std::unique_ptr<Chip8> m_Machines[LANES];
+
+    // Lanes currently in lockstep, one bit each, and the PC they share
+    uint32_t m_Group = 0;
+    int m_GroupSize = 0;
+    WORD m_PC = 0;
+
+    // Whether every lane in the group is known to have the same code below
+    // CODE_ADDRESS_LIMIT, so fetches don't need checking. Lost when a lane writes to
+    // memory, and lanes that ran alone (m_RanAlone) are checked again before they rejoin.
+    bool m_SharedCode = true;
+    uint32_t m_RanAlone = 0;
+
+    alignas(64) BYTE m_Registers[16][LANES];
+    alignas(64) WORD m_AddressI[LANES];
+    alignas(64) BYTE m_DelayTimer[LANES];
+    alignas(64) BYTE m_SoundTimer[LANES];
+
+    QuirkProfile m_Quirks = QUIRKS_LEGACY;
+    uint64_t m_LockstepInstructions = 0;
+    uint64_t m_ScalarInstructions = 0;
+};
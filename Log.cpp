@@ -0,0 +1,142 @@
+#include "Log.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+std::atomic<int> g_LogLevel(CHIP8_LOG_LEVEL);
+
+void SetLogLevel(LogLevel level) {
+    g_LogLevel.store(level, std::memory_order_relaxed);
+}
+
+// Must be a power of two
+const size_t LOG_RING_SIZE = 1024;
+
+// How long the writer thread naps when there's nothing to write
+const std::chrono::milliseconds LOG_IDLE_SLEEP(2);
+
+static const char* const s_LevelNames[] = { "error", "warn", "info", "debug", "trace" };
+
+// A bounded multi-producer queue: each slot's sequence number says whether it's free
+// for the producer that claimed that position, or full and ready for the writer.
+class LogRing {
+public:
+    LogRing() {
+        for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+            m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_Writer = std::thread(&LogRing::WriterLoop, this);
+    }
+
+    ~LogRing() {
+        m_Stop.store(true);
+        m_Writer.join();
+    }
+
+    bool Push(LogLevel level, const char* format, va_list args) {
+        size_t position = m_EnqueuePos.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &m_Slots[position & (LOG_RING_SIZE - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0) {
+                if (m_EnqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                m_Dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else {
+                position = m_EnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->level = level;
+        vsnprintf(slot->text, LOG_MESSAGE_SIZE, format, args);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    void Flush() {
+        size_t target = m_EnqueuePos.load();
+        while (m_DequeuePos.load() < target) {
+            std::this_thread::sleep_for(LOG_IDLE_SLEEP);
+        }
+        fflush(stderr);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        char text[LOG_MESSAGE_SIZE];
+    };
+
+    // Writes out everything that's ready. Only ever called from the writer thread.
+    bool Drain() {
+        bool wrote = false;
+        size_t position = m_DequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = m_Slots[position & (LOG_RING_SIZE - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+                break;
+            }
+
+            const char* text = slot.text;
+            size_t length = strlen(text);
+            bool newline = length > 0 && text[length - 1] == '\n';
+            fprintf(stderr, "[%s] %s%s", s_LevelNames[slot.level], text, newline ? "" : "\n");
+
+            slot.sequence.store(position + LOG_RING_SIZE, std::memory_order_release);
+            m_DequeuePos.store(++position, std::memory_order_release);
+            wrote = true;
+        }
+
+        uint64_t dropped = m_Dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped) {
+            fprintf(stderr, "[warn] %llu log messages dropped\n", (unsigned long long)dropped);
+        }
+        return wrote;
+    }
+
+    void WriterLoop() {
+        while (!m_Stop.load()) {
+            if (!Drain()) {
+                fflush(stderr);
+                std::this_thread::sleep_for(LOG_IDLE_SLEEP);
+            }
+        }
+        Drain();
+        fflush(stderr);
+    }
+
+    Slot m_Slots[LOG_RING_SIZE];
+    std::atomic<size_t> m_EnqueuePos{ 0 };
+    std::atomic<size_t> m_DequeuePos{ 0 };
+    std::atomic<uint64_t> m_Dropped{ 0 };
+    std::atomic<bool> m_Stop{ false };
+    std::thread m_Writer;
+};
+
+// Created (and its thread started) by the first message, torn down after main returns.
+static LogRing& GetLogRing() {
+    static LogRing ring;
+    return ring;
+}
+
+void LogWrite(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    GetLogRing().Push(level, format, args);
+    va_end(args);
+}
+
+void LogFlush() {
+    GetLogRing().Flush();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Logging
+// Messages are formatted straight into a fixed ring of slots and written out by a
+// background thread, so a caller only ever pays for a vsnprintf and a couple of atomics,
+// never for console I/O. If the ring is full the message is dropped (and counted)
+// rather than making the caller wait.
+//
+// Levels above CHIP8_LOG_LEVEL are compiled out entirely, arguments and all:
+//   -DCHIP8_LOG_LEVEL=4 keeps everything down to LOG_TRACE.
+// Everything goes to stderr, so it never gets mixed into the headless build's results.
+
+#include <atomic>
+
+enum LogLevel {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_TRACE,
+};
+
+#ifndef CHIP8_LOG_LEVEL
+#define CHIP8_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Messages longer than this are cut short.
+const int LOG_MESSAGE_SIZE = 240;
+
+// Runtime filter on top of the compile-time one. Defaults to CHIP8_LOG_LEVEL.
+void SetLogLevel(LogLevel level);
+extern std::atomic<int> g_LogLevel;
+
+// Queue a message. Use the LOG_* macros rather than calling this directly.
+void LogWrite(LogLevel level, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+// Block until everything queued so far has been written.
+void LogFlush();
+
+#define CHIP8_LOG(level, ...) \
+    do { \
+        if ((level) <= CHIP8_LOG_LEVEL && (level) <= g_LogLevel.load(std::memory_order_relaxed)) { \
+            LogWrite((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(...) CHIP8_LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  CHIP8_LOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  CHIP8_LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) CHIP8_LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(...) CHIP8_LOG(LOG_LEVEL_TRACE, __VA_ARGS__)
@@ -0,0 +1,229 @@
+#include "Movie.h"
+#include "Log.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+static const char MOVIE_MAGIC[4] = { 'C', '8', 'M', 'V' };
+static const size_t MOVIE_HEADER_SIZE = 4 + 2 + 1 + 1 + 4 + 8 + 8 + 8;
+
+WORD PackKeyboard(const Chip8& machine) {
+    WORD keys = 0;
+    for (int key = 0; key < 16; key++) {
+        if (machine.m_Keyboard[key]) {
+            keys |= (WORD)(1 << key);
+        }
+    }
+    return keys;
+}
+
+void UnpackKeyboard(WORD keys, Chip8& machine) {
+    for (int key = 0; key < 16; key++) {
+        machine.m_Keyboard[key] = (BYTE)((keys >> key) & 1);
+    }
+}
+
+static void PutInteger(std::vector<BYTE>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((BYTE)(value >> (8 * i)));
+    }
+}
+
+static void PutVarint(std::vector<BYTE>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((BYTE)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((BYTE)value);
+}
+
+// Reads off the front of a buffer. Running past the end (or a varint that never ends)
+// sets the failed flag and reads zeros from then on, so a truncated file is noticed once, at the end.
+struct MovieReader {
+    const BYTE* in;
+    const BYTE* end;
+    bool failed = false;
+
+    uint64_t Integer(int bytes) {
+        if (end - in < bytes) {
+            failed = true;
+            in = end;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= (uint64_t)*in++ << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t Varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (in == end) {
+                break;
+            }
+            BYTE b = *in++;
+            value |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        in = end;
+        return 0;
+    }
+};
+
+bool SaveMovie(const std::string& fname, const Movie& movie) {
+    std::vector<BYTE> out(MOVIE_MAGIC, MOVIE_MAGIC + sizeof(MOVIE_MAGIC));
+    PutInteger(out, MOVIE_VERSION, 2);
+    PutInteger(out, movie.quirks, 1);
+    PutInteger(out, 0, 1);
+    PutInteger(out, (uint32_t)movie.instructionsPerSecond, 4);
+    PutInteger(out, movie.romHash, 8);
+    PutInteger(out, movie.seed, 8);
+    PutInteger(out, movie.frames, 8);
+
+    PutVarint(out, movie.inputs.size());
+    uint64_t frame = 0;
+    for (const MovieInput& input : movie.inputs) {
+        PutVarint(out, input.frame - frame);
+        PutVarint(out, input.keys);
+        frame = input.frame;
+    }
+
+    PutVarint(out, movie.checkpoints.size());
+    frame = 0;
+    for (const MovieCheckpoint& checkpoint : movie.checkpoints) {
+        PutVarint(out, checkpoint.frame - frame);
+        PutInteger(out, checkpoint.displayHash, 8);
+        frame = checkpoint.frame;
+    }
+
+    std::ofstream file(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(reinterpret_cast<const char*>(out.data()), out.size())) {
+        LOG_ERROR("Unable to write movie %s", fname.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadMovie(const std::string& fname, Movie& movie) {
+    std::ifstream file(fname, std::ios::in | std::ios::binary);
+    if (!file) {
+        LOG_ERROR("Unable to open movie %s", fname.c_str());
+        return false;
+    }
+    std::vector<BYTE> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < MOVIE_HEADER_SIZE || !std::equal(MOVIE_MAGIC, MOVIE_MAGIC + sizeof(MOVIE_MAGIC), data.begin())) {
+        LOG_ERROR("%s is not a movie", fname.c_str());
+        return false;
+    }
+
+    MovieReader reader = { data.data() + sizeof(MOVIE_MAGIC), data.data() + data.size() };
+    WORD version = (WORD)reader.Integer(2);
+    if (version != MOVIE_VERSION) {
+        LOG_ERROR("Movie %s is version %d, this build only plays version %d", fname.c_str(), version, MOVIE_VERSION);
+        return false;
+    }
+    BYTE quirks = (BYTE)reader.Integer(1);
+    if (quirks >= QUIRK_PROFILE_COUNT) {
+        LOG_ERROR("Movie %s was recorded with an unknown quirk profile", fname.c_str());
+        return false;
+    }
+    reader.Integer(1);
+
+    Movie loaded;
+    loaded.quirks = (QuirkProfile)quirks;
+    loaded.instructionsPerSecond = (int)reader.Integer(4);
+    loaded.romHash = reader.Integer(8);
+    loaded.seed = reader.Integer(8);
+    loaded.frames = reader.Integer(8);
+
+    // Every record takes at least two bytes, which bounds the counts before anything is allocated.
+    uint64_t frame = 0;
+    uint64_t count = reader.Varint();
+    if (count > data.size() / 2) {
+        reader.failed = true;
+    }
+    for (uint64_t i = 0; i < count && !reader.failed; i++) {
+        frame += reader.Varint();
+        loaded.inputs.push_back({ frame, (WORD)reader.Varint() });
+    }
+
+    frame = 0;
+    count = reader.Varint();
+    if (count > data.size() / 2) {
+        reader.failed = true;
+    }
+    for (uint64_t i = 0; i < count && !reader.failed; i++) {
+        frame += reader.Varint();
+        loaded.checkpoints.push_back({ frame, reader.Integer(8) });
+    }
+
+    if (reader.failed) {
+        LOG_ERROR("Movie %s is truncated or corrupt", fname.c_str());
+        return false;
+    }
+    movie = std::move(loaded);
+    return true;
+}
+
+MovieRecorder::MovieRecorder(int checkpointInterval)
+    : m_CheckpointInterval(checkpointInterval > 0 ? checkpointInterval : 1) {
+}
+
+void MovieRecorder::Begin(const Chip8& machine, uint64_t romHash, int instructionsPerSecond) {
+    m_Movie = Movie();
+    m_Movie.romHash = romHash;
+    m_Movie.seed = machine.m_RandomSeed;
+    m_Movie.quirks = machine.m_Quirks;
+    m_Movie.instructionsPerSecond = instructionsPerSecond;
+    m_Keys = 0;
+}
+
+void MovieRecorder::BeginFrame(const Chip8& machine) {
+    WORD keys = PackKeyboard(machine);
+    if (keys != m_Keys) {
+        m_Movie.inputs.push_back({ m_Movie.frames, keys });
+        m_Keys = keys;
+    }
+}
+
+void MovieRecorder::EndFrame(const Chip8& machine) {
+    m_Movie.frames++;
+    if (m_Movie.frames % m_CheckpointInterval == 0) {
+        m_Movie.checkpoints.push_back({ m_Movie.frames, machine.HashDisplay() });
+    }
+}
+
+const Movie& MovieRecorder::Finish(const Chip8& machine) {
+    if (m_Movie.frames > 0 && (m_Movie.checkpoints.empty() || m_Movie.checkpoints.back().frame != m_Movie.frames)) {
+        m_Movie.checkpoints.push_back({ m_Movie.frames, machine.HashDisplay() });
+    }
+    return m_Movie;
+}
+
+void MoviePlayer::Configure(Chip8& machine) const {
+    machine.m_RandomSeed = m_Movie.seed;
+    machine.m_Quirks = m_Movie.quirks;
+}
+
+void MoviePlayer::BeginFrame(uint64_t frame, Chip8& machine) {
+    for (; m_NextInput < m_Movie.inputs.size() && m_Movie.inputs[m_NextInput].frame <= frame; m_NextInput++) {
+        UnpackKeyboard(m_Movie.inputs[m_NextInput].keys, machine);
+    }
+}
+
+bool MoviePlayer::EndFrame(uint64_t frames, const Chip8& machine) {
+    bool matched = true;
+    for (; m_NextCheckpoint < m_Movie.checkpoints.size() && m_Movie.checkpoints[m_NextCheckpoint].frame <= frames; m_NextCheckpoint++) {
+        if (m_Movie.checkpoints[m_NextCheckpoint].frame == frames &&
+            m_Movie.checkpoints[m_NextCheckpoint].displayHash != machine.HashDisplay()) {
+            matched = false;
+        }
+    }
+    return matched;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Input movies
+// A movie is everything needed to play a session back exactly: which ROM, the seed,
+// quirk profile and speed it ran at, and the state of the keypad on every frame. The
+// core is deterministic given those, so a movie replays bit-for-bit, as fast as the
+// host can go and with nothing drawn. Every so often the recorder also notes a hash of
+// the screen, and the player checks each one as it goes by, so a replay that drifts
+// from the original says where.
+//
+// On disk (all integers little-endian, "varint" as in Snapshot.cpp):
+//   "C8MV", u16 version, u8 quirk profile, u8 reserved, u32 instructions per second,
+//   u64 ROM hash, u64 seed, u64 frames
+//   varint input count, then per input:           varint frames since the last one, varint key mask
+//   varint checkpoint count, then per checkpoint: varint frames since the last one, u64 display hash
+// Only frames where the keypad changed are stored, so an hour of play is a few KB.
+
+#include "Chip8.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const WORD MOVIE_VERSION = 1;
+
+// Frames between display hash checkpoints, about one per second of play
+const int DEFAULT_MOVIE_CHECKPOINT_INTERVAL = 60;
+
+// From this frame on the keypad looks like keys (bit k set = key k down).
+struct MovieInput {
+    uint64_t frame;
+    WORD keys;
+};
+
+// HashDisplay() once frame frames have run
+struct MovieCheckpoint {
+    uint64_t frame;
+    uint64_t displayHash;
+};
+
+struct Movie {
+    uint64_t romHash = 0;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+    QuirkProfile quirks = QUIRKS_LEGACY;
+    int instructionsPerSecond = 700;
+    uint64_t frames = 0;
+
+    // Both in frame order
+    std::vector<MovieInput> inputs;
+    std::vector<MovieCheckpoint> checkpoints;
+};
+
+WORD PackKeyboard(const Chip8& machine);
+void UnpackKeyboard(WORD keys, Chip8& machine);
+
+// Both print what went wrong and return false on failure.
+bool SaveMovie(const std::string& fname, const Movie& movie);
+bool LoadMovie(const std::string& fname, Movie& movie);
+
+// Records a movie from whoever drives the machine. Call BeginFrame() once the frame's
+// key changes have been applied and EndFrame() after its timers have ticked.
+class MovieRecorder {
+public:
+    explicit MovieRecorder(int checkpointInterval = DEFAULT_MOVIE_CHECKPOINT_INTERVAL);
+
+    // Start a new movie. The machine must have just been reset.
+    void Begin(const Chip8& machine, uint64_t romHash, int instructionsPerSecond);
+
+    void BeginFrame(const Chip8& machine);
+    void EndFrame(const Chip8& machine);
+
+    // Adds a checkpoint for the last frame if the interval didn't just land on it.
+    const Movie& Finish(const Chip8& machine);
+
+    const Movie& GetMovie() const { return m_Movie; }
+
+private:
+    Movie m_Movie;
+    int m_CheckpointInterval;
+    WORD m_Keys = 0;
+};
+
+// Plays a movie back onto a machine, one frame at a time. The machine must be reset
+// with the movie's seed and quirk profile first (see Configure()).
+class MoviePlayer {
+public:
+    explicit MoviePlayer(const Movie& movie) : m_Movie(movie) {}
+
+    // Seed and quirk profile, before the machine's CPUReset()
+    void Configure(Chip8& machine) const;
+
+    // Set the keypad as it was at the start of frame (0-based, in order).
+    void BeginFrame(uint64_t frame, Chip8& machine);
+
+    // Check the screen once frames have run. Returns false if there was a checkpoint
+    // here and the screen doesn't match it.
+    bool EndFrame(uint64_t frames, const Chip8& machine);
+
+    // Checkpoints EndFrame() has gone past so far
+    size_t CheckpointsChecked() const { return m_NextCheckpoint; }
+
+private:
+    const Movie& m_Movie;
+    size_t m_NextInput = 0;
+    size_t m_NextCheckpoint = 0;
+};
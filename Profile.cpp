@@ -0,0 +1,92 @@
+#include "Chip8.h"
+#include <algorithm>
+#include <cinttypes>
+#include <vector>
+
+static const char* const s_OpcodeNames[OP_COUNT] = {
+#define CHIP8_OPCODE_NAME(name) #name,
+    CHIP8_OPCODES(CHIP8_OPCODE_NAME)
+#undef CHIP8_OPCODE_NAME
+};
+
+// How many of the hottest addresses get listed individually
+const int HOT_ADDRESS_COUNT = 16;
+
+// Addresses per character of the heatmap
+const int HEATMAP_CELL = 16;
+const int HEATMAP_ROW = 64 * HEATMAP_CELL;
+
+static double Percent(uint64_t part, uint64_t total) {
+    return total ? part * 100.0 / total : 0.0;
+}
+
+void Chip8::DumpProfile(FILE* out) const {
+    const ProfileCounters* counters = m_Profiler.Counters();
+    if (!counters) {
+        fprintf(out, "Profiling isn't compiled in. Rebuild with -DCHIP8_PROFILE=1.\n");
+        return;
+    }
+
+    const uint64_t total = counters->instructions;
+    fprintf(out, "profile: instructions=%" PRIu64 " draws=%" PRIu64 " clears=%" PRIu64
+            " calls=%" PRIu64 " returns=%" PRIu64 " max_stack_depth=%d\n",
+            total, counters->draws, counters->clears, counters->calls, counters->returns,
+            counters->maxStackDepth);
+
+    // Opcode kinds, busiest first
+    std::vector<int> kinds;
+    for (int kind = 0; kind < OP_COUNT; kind++) {
+        if (counters->opcodes[kind]) {
+            kinds.push_back(kind);
+        }
+    }
+    std::sort(kinds.begin(), kinds.end(), [counters](int a, int b) {
+        return counters->opcodes[a] > counters->opcodes[b];
+    });
+    fprintf(out, "opcodes:\n");
+    for (int kind : kinds) {
+        fprintf(out, "  %-8s %12" PRIu64 " %6.2f%%\n", s_OpcodeNames[kind], counters->opcodes[kind],
+                Percent(counters->opcodes[kind], total));
+    }
+
+    std::vector<int> addresses;
+    for (int pc = 0; pc < 0x1000; pc++) {
+        if (counters->pcHeat[pc]) {
+            addresses.push_back(pc);
+        }
+    }
+    size_t listed = std::min(addresses.size(), (size_t)HOT_ADDRESS_COUNT);
+    std::partial_sort(addresses.begin(), addresses.begin() + listed, addresses.end(), [counters](int a, int b) {
+        return counters->pcHeat[a] > counters->pcHeat[b];
+    });
+    fprintf(out, "hot addresses:\n");
+    for (size_t i = 0; i < listed; i++) {
+        int pc = addresses[i];
+        WORD opcode = (WORD)((m_GameMemory[pc % m_GameMemory.size()] << 8) | m_GameMemory[(pc + 1) % m_GameMemory.size()]);
+        fprintf(out, "  %03X %04X %-8s %12" PRIu64 " %6.2f%%\n", pc, opcode, s_OpcodeNames[GetDecodeTable()[opcode].kind],
+                counters->pcHeat[pc], Percent(counters->pcHeat[pc], total));
+    }
+
+    // One character per HEATMAP_CELL addresses: '.' never ran, then 1-9 by share of the hottest cell.
+    uint64_t hottest = 0;
+    for (int cell = 0; cell < 0x1000; cell += HEATMAP_CELL) {
+        uint64_t sum = 0;
+        for (int pc = cell; pc < cell + HEATMAP_CELL; pc++) {
+            sum += counters->pcHeat[pc];
+        }
+        hottest = std::max(hottest, sum);
+    }
+    fprintf(out, "heatmap (%d addresses per cell):\n", HEATMAP_CELL);
+    for (int row = 0; row < 0x1000; row += HEATMAP_ROW) {
+        char line[HEATMAP_ROW / HEATMAP_CELL + 1];
+        for (int cell = 0; cell < HEATMAP_ROW / HEATMAP_CELL; cell++) {
+            uint64_t sum = 0;
+            for (int pc = row + cell * HEATMAP_CELL; pc < row + (cell + 1) * HEATMAP_CELL; pc++) {
+                sum += counters->pcHeat[pc];
+            }
+            line[cell] = sum == 0 ? '.' : (char)('1' + std::min<uint64_t>(8, sum * 8 / hottest));
+        }
+        line[HEATMAP_ROW / HEATMAP_CELL] = '\0';
+        fprintf(out, "  %03X %s\n", row, line);
+    }
+}
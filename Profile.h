@@ -0,0 +1,70 @@
+#pragma once
+
+// Hot-path instrumentation
+// Build with -DCHIP8_PROFILE=1 (or `mingw32-make profile`) to count every instruction by
+// opcode kind and by address, plus how often the screen is drawn to and cleared and how
+// deep the call stack gets. In a normal build Profiler<false> is empty and every hook
+// compiles away to nothing, so the interpreter loops are exactly what they were.
+
+#include "Types.h"
+#include <cstdint>
+#include <cstring>
+
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+
+struct ProfileCounters {
+    uint64_t instructions;
+    uint64_t opcodes[256];      // indexed by OpKind
+    uint64_t pcHeat[0x1000];    // indexed by address
+    uint64_t draws;
+    uint64_t clears;
+    uint64_t calls;
+    uint64_t returns;
+    int maxStackDepth;
+};
+
+template <bool Enabled>
+class Profiler {
+public:
+    static const bool enabled = false;
+
+    void Instruction(int, BYTE) {}
+    void Draw() {}
+    void Clear() {}
+    void Call(int) {}
+    void Return() {}
+    void Reset() {}
+    const ProfileCounters* Counters() const { return nullptr; }
+};
+
+template <>
+class Profiler<true> {
+public:
+    static const bool enabled = true;
+
+    Profiler() { Reset(); }
+
+    void Instruction(int pc, BYTE kind) {
+        m_Counters.instructions++;
+        m_Counters.opcodes[kind]++;
+        m_Counters.pcHeat[pc & 0xFFF]++;
+    }
+    void Draw() { m_Counters.draws++; }
+    void Clear() { m_Counters.clears++; }
+    void Call(int depth) {
+        m_Counters.calls++;
+        if (depth > m_Counters.maxStackDepth) {
+            m_Counters.maxStackDepth = depth;
+        }
+    }
+    void Return() { m_Counters.returns++; }
+    void Reset() { memset(&m_Counters, 0, sizeof(m_Counters)); }
+    const ProfileCounters* Counters() const { return &m_Counters; }
+
+private:
+    ProfileCounters m_Counters;
+};
+
+typedef Profiler<CHIP8_PROFILE != 0> MachineProfiler;
@@ -0,0 +1,78 @@
+#include "Quirks.h"
+#include "Log.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+const char* QuirkProfileName(QuirkProfile profile) {
+    switch (profile) {
+#define CHIP8_QUIRK_NAME(id, policy, name) case QUIRKS_##id: return name;
+        CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_NAME)
+#undef CHIP8_QUIRK_NAME
+        default: break;
+    }
+    return "unknown";
+}
+
+unsigned int QuirkMemorySize(QuirkProfile profile) {
+    switch (profile) {
+#define CHIP8_QUIRK_MEMORY(id, policy, name) case QUIRKS_##id: return policy::memoryMask + 1;
+        CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_MEMORY)
+#undef CHIP8_QUIRK_MEMORY
+        default: break;
+    }
+    return QuirksLegacy::memoryMask + 1;
+}
+
+bool ParseQuirkProfile(const char* name, QuirkProfile& profile) {
+    for (int i = 0; i < QUIRK_PROFILE_COUNT; i++) {
+        if (strcmp(name, QuirkProfileName((QuirkProfile)i)) == 0) {
+            profile = (QuirkProfile)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LoadQuirkDatabase(const std::string& fname, QuirkDatabase& database) {
+    std::ifstream file(fname);
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string hash, name;
+        if (!(fields >> hash)) {
+            continue;
+        }
+
+        QuirkProfile profile;
+        if (!(fields >> name) || !ParseQuirkProfile(name.c_str(), profile)) {
+            LOG_ERROR("%s:%d: expected <hash> <legacy|vip|chip48|schip|xochip>", fname.c_str(), lineNumber);
+            continue;
+        }
+        database[strtoull(hash.c_str(), nullptr, 16)] = profile;
+    }
+    return true;
+}
+
+QuirkProfile LookupQuirkProfile(const QuirkDatabase& database, uint64_t romHash, QuirkProfile fallback) {
+    auto entry = database.find(romHash);
+    return entry != database.end() ? entry->second : fallback;
+}
+
+QuirkProfile ChooseQuirkProfile(const std::string& fname, uint64_t romHash) {
+    QuirkDatabase database;
+    LoadQuirkDatabase(fname, database);
+
+    QuirkProfile profile = LookupQuirkProfile(database, romHash, QUIRKS_LEGACY);
+    LOG_INFO("Quirk profile %s for ROM %016llx", QuirkProfileName(profile), (unsigned long long)romHash);
+    return profile;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+// Quirk profiles
+// The interpreters people wrote CHIP-8 games against disagree on a handful of opcodes.
+// Each profile below is a policy struct of compile-time constants, and the core
+// instantiates its handlers, switch and threaded loop once per profile. Profiles are
+// picked per machine (Chip8::m_Quirks), so a quirk costs nothing at run time: all the
+// code that runs was compiled with the answer already known.
+//
+//   legacy  - what this interpreter has always done: 8XY6 shifts VY and writes it back
+//             to both VX and VY, 8XYE shifts VX, FX55/FX65 leave I past the last register,
+//             8XY4 carries when VY > VX, 8XY7 does VX -= VY, 8XY4-8XYE set VF before
+//             reading their operands, and EX9E/EXA1 compare VX against key X's state
+//             instead of testing key VX
+//   vip     - the original COSMAC VIP interpreter
+//   chip48  - CHIP-48 on the HP-48
+//   schip   - SUPER-CHIP 1.1
+//   xochip  - XO-CHIP, as Octo runs it: 64K of memory, and skips step over F000 NNNN
+//
+// The SCHIP and XO-CHIP opcodes themselves decode under every profile.
+
+#include "Types.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// id, policy struct, name on the command line
+#define CHIP8_QUIRK_PROFILES(X) \
+    X(LEGACY, QuirksLegacy, "legacy") \
+    X(VIP, QuirksVIP, "vip") \
+    X(CHIP48, QuirksCHIP48, "chip48") \
+    X(SCHIP, QuirksSCHIP, "schip") \
+    X(XOCHIP, QuirksXOCHIP, "xochip")
+
+enum QuirkProfile : BYTE {
+#define CHIP8_QUIRK_ENUM(id, policy, name) QUIRKS_##id,
+    CHIP8_QUIRK_PROFILES(CHIP8_QUIRK_ENUM)
+#undef CHIP8_QUIRK_ENUM
+    QUIRK_PROFILE_COUNT
+};
+
+// What 8XY6 and 8XYE shift
+enum ShiftQuirk {
+    SHIFT_LEGACY,       // 8XY6: VX = VY = VY >> 1, 8XYE: VX <<= 1
+    SHIFT_VY,           // VX = VY shifted, VY untouched
+    SHIFT_VX,           // VX shifted in place, VY ignored
+};
+
+// What FX55 and FX65 leave in I
+enum LoadStoreQuirk {
+    LOAD_STORE_I_PLUS_X_PLUS_1,
+    LOAD_STORE_I_PLUS_X,
+    LOAD_STORE_I_UNCHANGED,
+};
+
+struct QuirksLegacy {
+    static const ShiftQuirk shift = SHIFT_LEGACY;
+    static const LoadStoreQuirk loadStore = LOAD_STORE_I_PLUS_X_PLUS_1;
+    static const bool jumpUsesVX = false;       // BNNN jumps to XNN + VX instead of NNN + V0
+    static const bool wrapSprites = false;      // DXYN wraps at the edges instead of clipping
+    static const bool logicResetsVF = false;    // 8XY1/8XY2/8XY3 clear VF
+    static const int memoryMask = 0xFFF;        // addresses I can reach
+    static const bool longSkips = false;        // skips step over all four bytes of F000 NNNN
+    static const bool legacyArithmetic = true;  // 8XY4, 8XY5 and 8XY7 as this interpreter first had them
+    static const bool legacyKeyTest = true;     // EX9E/EXA1 compare VX with m_Keyboard[X]
+};
+
+struct QuirksVIP {
+    static const ShiftQuirk shift = SHIFT_VY;
+    static const LoadStoreQuirk loadStore = LOAD_STORE_I_PLUS_X_PLUS_1;
+    static const bool jumpUsesVX = false;
+    static const bool wrapSprites = false;
+    static const bool logicResetsVF = true;
+    static const int memoryMask = 0xFFF;
+    static const bool longSkips = false;
+    static const bool legacyArithmetic = false;
+    static const bool legacyKeyTest = false;
+};
+
+struct QuirksCHIP48 {
+    static const ShiftQuirk shift = SHIFT_VX;
+    static const LoadStoreQuirk loadStore = LOAD_STORE_I_PLUS_X;
+    static const bool jumpUsesVX = true;
+    static const bool wrapSprites = false;
+    static const bool logicResetsVF = false;
+    static const int memoryMask = 0xFFF;
+    static const bool longSkips = false;
+    static const bool legacyArithmetic = false;
+    static const bool legacyKeyTest = false;
+};
+
+struct QuirksSCHIP {
+    static const ShiftQuirk shift = SHIFT_VX;
+    static const LoadStoreQuirk loadStore = LOAD_STORE_I_UNCHANGED;
+    static const bool jumpUsesVX = true;
+    static const bool wrapSprites = false;
+    static const bool logicResetsVF = false;
+    static const int memoryMask = 0xFFF;
+    static const bool longSkips = false;
+    static const bool legacyArithmetic = false;
+    static const bool legacyKeyTest = false;
+};
+
+struct QuirksXOCHIP {
+    static const ShiftQuirk shift = SHIFT_VY;
+    static const LoadStoreQuirk loadStore = LOAD_STORE_I_PLUS_X_PLUS_1;
+    static const bool jumpUsesVX = false;
+    static const bool wrapSprites = true;
+    static const bool logicResetsVF = false;
+    static const int memoryMask = 0xFFFF;
+    static const bool longSkips = true;
+    static const bool legacyArithmetic = false;
+    static const bool legacyKeyTest = false;
+};
+
+const char* QuirkProfileName(QuirkProfile profile);
+
+// How many bytes of memory a profile can reach: its memoryMask + 1
+unsigned int QuirkMemorySize(QuirkProfile profile);
+bool ParseQuirkProfile(const char* name, QuirkProfile& profile);
+
+// ROM hash (see HashROMData) -> the profile it was written for.
+typedef std::unordered_map<uint64_t, QuirkProfile> QuirkDatabase;
+
+// Read a quirk database. One ROM per line:
+//   <hash, 16 hex digits> <profile name>
+// Anything after a '#' is ignored. Returns false if the file can't be opened.
+bool LoadQuirkDatabase(const std::string& fname, QuirkDatabase& database);
+
+// The profile the database has for a ROM, or fallback if it isn't listed.
+QuirkProfile LookupQuirkProfile(const QuirkDatabase& database, uint64_t romHash, QuirkProfile fallback);
+
+// Where the frontends look for the database when no profile is given on the command line
+const char* const DEFAULT_QUIRK_DATABASE = "ROMS/quirks.txt";
+
+// Load the database at fname (a missing file just means an empty database) and look
+// the ROM up in it. Anything not listed runs as QUIRKS_LEGACY.
+QuirkProfile ChooseQuirkProfile(const std::string& fname, uint64_t romHash);
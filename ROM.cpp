@@ -0,0 +1,175 @@
+#include "ROM.h"
+#include "Log.h"
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const char* fname) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (view) {
+                    m_FileHandle = file;
+                    m_MappingHandle = mapping;
+                    m_Data = static_cast<const BYTE*>(view);
+                    m_Size = (size_t)fileSize.QuadPart;
+                    m_IsMapped = true;
+                    return true;
+                }
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = open(fname, O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+
+                // The mapping stays valid after the descriptor is closed.
+                close(fd);
+                m_Data = static_cast<const BYTE*>(view);
+                m_Size = (size_t)info.st_size;
+                m_IsMapped = true;
+                return true;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    // Couldn't map it, so read the whole file into a buffer instead.
+    std::ifstream ROM(fname, std::ios::in | std::ios::binary);
+    if (!ROM) {
+        return false;
+    }
+
+    ROM.seekg(0, std::ios::end);
+    std::streamoff bufferSize = ROM.tellg();
+    ROM.seekg(0, std::ios::beg);
+    if (bufferSize <= 0) {
+        return false;
+    }
+
+    m_Buffer.resize((size_t)bufferSize);
+    ROM.read(reinterpret_cast<char*>(m_Buffer.data()), bufferSize);
+    m_Data = m_Buffer.data();
+    m_Size = m_Buffer.size();
+    return true;
+}
+
+bool MappedFile::OpenMemory(const BYTE* data, size_t size) {
+    Close();
+    if (size == 0) {
+        return false;
+    }
+
+    m_Buffer.assign(data, data + size);
+    m_Data = m_Buffer.data();
+    m_Size = m_Buffer.size();
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_IsMapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_MappingHandle);
+        CloseHandle(m_FileHandle);
+        m_MappingHandle = nullptr;
+        m_FileHandle = nullptr;
+#else
+        munmap(const_cast<BYTE*>(m_Data), m_Size);
+#endif
+    }
+
+    m_Buffer.clear();
+    m_Buffer.shrink_to_fit();
+    m_Data = nullptr;
+    m_Size = 0;
+    m_IsMapped = false;
+}
+
+uint64_t HashROMData(const BYTE* data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+const ROMImage* ROMCache::Load(const std::string& fname) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // Already seen this path? Then we're done.
+    auto knownPath = m_PathToHash.find(fname);
+    if (knownPath != m_PathToHash.end()) {
+        return m_Images[knownPath->second].get();
+    }
+
+    std::unique_ptr<ROMImage> image(new ROMImage());
+    image->path = fname;
+
+    if (!image->file.Open(fname.c_str())) {
+        LOG_ERROR("Error loading the ROM %s. This occurs if the file does not exist or the name does not exist.", fname.c_str());
+        return nullptr;
+    }
+
+    if (image->Size() > MAX_ROM_SIZE) {
+        LOG_ERROR("ROM %s is too large. Please load another ROM file.", fname.c_str());
+        return nullptr;
+    }
+
+    image->hash = HashROMData(image->Data(), image->Size());
+    m_PathToHash[fname] = image->hash;
+
+    // Two paths with the same contents share one image; the duplicate mapping is dropped here.
+    auto existing = m_Images.find(image->hash);
+    if (existing != m_Images.end()) {
+        return existing->second.get();
+    }
+
+    const ROMImage* result = image.get();
+    m_Images[image->hash] = std::move(image);
+    return result;
+}
+
+const ROMImage* ROMCache::Find(uint64_t hash) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Images.find(hash);
+    return it != m_Images.end() ? it->second.get() : nullptr;
+}
+
+void ROMCache::Clear() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_PathToHash.clear();
+    m_Images.clear();
+}
+
+size_t ROMCache::Count() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Images.size();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// ROM subsystem
+// Each .ch8 file is loaded (memory-mapped when the OS lets us) exactly once and kept
+// in a cache keyed by a hash of its contents. The interpreter only ever copies
+// from these images at CPUReset() time, so restarting a run never touches the filesystem.
+
+#include "Types.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// CHIP-8 programs begin at address 0x200. Every machine has XO-CHIP's 64K of memory, but
+// only XO-CHIP ROMs can reach past the first 4K, and code never lives past it since
+// that's as far as 1NNN and 2NNN can jump. The cache takes ROMs up to MAX_ROM_SIZE;
+// anything bigger than the profile it runs under can reach is refused once the profile
+// is known (see ROMFitsQuirkProfile).
+const unsigned int ROM_START_ADDRESS = 0x200;
+const unsigned int MEMORY_SIZE = 0x10000;
+const unsigned int CODE_ADDRESS_LIMIT = 0x1000;
+const unsigned int MAX_ROM_SIZE = MEMORY_SIZE - ROM_START_ADDRESS;
+
+// A read-only view of a ROM file on disk. Backed by an mmap'd (or MapViewOfFile'd) view
+// when possible, otherwise by a plain heap buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* fname);
+
+    // Take a private copy of an image that's already in memory, e.g. a ROM built on the fly.
+    bool OpenMemory(const BYTE* data, size_t size);
+
+    void Close();
+
+    const BYTE* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+
+private:
+    const BYTE* m_Data = nullptr;
+    size_t m_Size = 0;
+    bool m_IsMapped = false;
+
+    // Fallback storage when the file can't be mapped
+    std::vector<BYTE> m_Buffer;
+
+#ifdef _WIN32
+    void* m_FileHandle = nullptr;
+    void* m_MappingHandle = nullptr;
+#endif
+};
+
+// A ROM image that has been validated and hashed.
+struct ROMImage {
+    std::string path;
+    uint64_t hash = 0;
+    MappedFile file;
+
+    const BYTE* Data() const { return file.Data(); }
+    size_t Size() const { return file.Size(); }
+};
+
+// 64-bit FNV-1a over the ROM contents. Cheap, and more than good enough to tell ROMs apart.
+uint64_t HashROMData(const BYTE* data, size_t size);
+
+// Safe to share between threads.
+class ROMCache {
+public:
+    // Returns the cached image for fname, loading it on first use.
+    // Returns nullptr if the file is missing, empty, or too big to fit in memory.
+    const ROMImage* Load(const std::string& fname);
+
+    // Looks up an already-loaded image by its content hash.
+    const ROMImage* Find(uint64_t hash) const;
+
+    void Clear();
+    size_t Count() const;
+
+private:
+    mutable std::mutex m_Mutex;
+    std::unordered_map<std::string, uint64_t> m_PathToHash;
+    std::unordered_map<uint64_t, std::unique_ptr<ROMImage>> m_Images;
+};
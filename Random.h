@@ -0,0 +1,33 @@
+#pragma once
+
+// Per-machine random numbers for CXNN
+// A PCG32 generator (https://www.pcg-random.org): 16 bytes of state, no locks, no
+// globals, and the same sequence on every host and compiler for a given seed. The
+// state is part of the machine, so it goes into snapshots and state hashes like
+// everything else, and a replay from the same seed is bit-for-bit the same run.
+
+#include <cstdint>
+
+// What every machine is seeded with unless told otherwise
+const uint64_t DEFAULT_RANDOM_SEED = 0x853C49E6748FEA9Bull;
+
+struct PCG32 {
+    uint64_t state = 0;
+    uint64_t increment = 1;
+
+    void Seed(uint64_t seed, uint64_t stream = 0xDA3E39CB94B95BDBull) {
+        state = 0;
+        increment = (stream << 1) | 1;
+        Next();
+        state += seed;
+        Next();
+    }
+
+    uint32_t Next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + increment;
+        uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t)(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+};
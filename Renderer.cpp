@@ -0,0 +1,183 @@
+#include "Renderer.h"
+#include "Log.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+// 3x5 overlay font. Each glyph is five rows, top first, with bit 2 the leftmost column.
+static const struct {
+    char c;
+    uint8_t rows[5];
+} OVERLAY_FONT[] = {
+    { '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } }, { '2', { 7, 1, 7, 4, 7 } },
+    { '3', { 7, 1, 3, 1, 7 } }, { '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } },
+    { '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 1, 2, 2 } }, { '8', { 7, 5, 7, 5, 7 } },
+    { '9', { 7, 5, 7, 1, 7 } }, { '.', { 0, 0, 0, 0, 2 } }, { ':', { 0, 2, 0, 2, 0 } },
+    { 'F', { 7, 4, 6, 4, 4 } }, { 'I', { 7, 2, 2, 2, 7 } }, { 'K', { 5, 5, 6, 5, 5 } },
+    { 'M', { 5, 7, 7, 5, 5 } }, { 'P', { 6, 5, 6, 4, 4 } }, { 'S', { 3, 4, 2, 1, 6 } },
+    { 'X', { 5, 5, 2, 5, 5 } },
+};
+
+FrameRenderer::~FrameRenderer() {
+    Destroy();
+}
+
+static const char* const SCALE_MODE_NAMES[] = { "stretch", "fit", "integer", "crt" };
+
+const char* ScaleModeName(ScaleMode mode) {
+    return mode >= SCALE_STRETCH && mode <= SCALE_CRT ? SCALE_MODE_NAMES[mode] : "unknown";
+}
+
+bool ParseScaleMode(const char* name, ScaleMode& mode) {
+    for (int i = SCALE_STRETCH; i <= SCALE_CRT; i++) {
+        if (strcmp(name, SCALE_MODE_NAMES[i]) == 0) {
+            mode = (ScaleMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameRenderer::Init(SDL_Renderer* renderer, int width, int height) {
+    Destroy();
+
+    // Nearest neighbour scaling keeps the pixels nice and blocky.
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+
+    // Set game screen to be a texture with RGBA8888 format.
+    // Because the CHIP-8 is developed in a big endian fashion,
+    // this format is the most suited candidate.
+    // Read more about this: https://en.wikipedia.org/wiki/RGBA_color_model
+    m_Texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!m_Texture) {
+        LOG_ERROR("gameScreen cannot be loaded. See more: %s", SDL_GetError());
+        return false;
+    }
+
+    m_Renderer = renderer;
+    m_Width = width;
+    m_Height = height;
+    return CreateScanlines();
+}
+
+bool FrameRenderer::CreateScanlines() {
+    m_Scanlines = SDL_CreateTexture(m_Renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, 1, m_Height * 2);
+    if (!m_Scanlines) {
+        LOG_ERROR("Scanlines cannot be loaded. See more: %s", SDL_GetError());
+        return false;
+    }
+
+    std::vector<uint32_t> rows(m_Height * 2);
+    for (size_t row = 0; row < rows.size(); row++) {
+        rows[row] = row & 1 ? 0x00000060 : 0x00000000;
+    }
+    SDL_UpdateTexture(m_Scanlines, NULL, rows.data(), sizeof(uint32_t));
+    SDL_SetTextureBlendMode(m_Scanlines, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+void FrameRenderer::Destroy() {
+    if (m_Texture) {
+        SDL_DestroyTexture(m_Texture);
+        m_Texture = nullptr;
+    }
+    if (m_Scanlines) {
+        SDL_DestroyTexture(m_Scanlines);
+        m_Scanlines = nullptr;
+    }
+    m_Renderer = nullptr;
+}
+
+uint32_t* FrameRenderer::Lock(int& pitch, int firstRow, int rowCount) {
+    if (rowCount < 0) {
+        rowCount = m_Height - firstRow;
+    }
+    SDL_Rect rows = { 0, firstRow, m_Width, rowCount };
+
+    void* pixels = nullptr;
+    int bytePitch = 0;
+    if (!m_Texture || SDL_LockTexture(m_Texture, &rows, &pixels, &bytePitch) != 0) {
+        LOG_ERROR("Unable to lock the game screen: %s", SDL_GetError());
+        return nullptr;
+    }
+    pitch = bytePitch / (int)sizeof(uint32_t);
+    return static_cast<uint32_t*>(pixels);
+}
+
+void FrameRenderer::Unlock() {
+    SDL_UnlockTexture(m_Texture);
+}
+
+SDL_Rect FrameRenderer::Destination(int windowWidth, int windowHeight) const {
+    if (scaleMode == SCALE_STRETCH || m_Width <= 0 || m_Height <= 0) {
+        return { 0, 0, windowWidth, windowHeight };
+    }
+
+    int width, height;
+    if (scaleMode == SCALE_FIT) {
+        width = windowWidth;
+        height = windowWidth * m_Height / m_Width;
+        if (height > windowHeight) {
+            height = windowHeight;
+            width = windowHeight * m_Width / m_Height;
+        }
+    }
+    else {
+
+        // A window smaller than the native screen still gets the screen, just squashed.
+        int scale = std::max(1, std::min(windowWidth / m_Width, windowHeight / m_Height));
+        width = m_Width * scale;
+        height = m_Height * scale;
+    }
+    return { (windowWidth - width) / 2, (windowHeight - height) / 2, width, height };
+}
+
+void FrameRenderer::Draw() {
+    int windowWidth = 0;
+    int windowHeight = 0;
+    SDL_GetRendererOutputSize(m_Renderer, &windowWidth, &windowHeight);
+    SDL_Rect destination = Destination(windowWidth, windowHeight);
+
+    // Clear the bars around the screen, if any.
+    SDL_SetRenderDrawColor(m_Renderer, 0, 0, 0, 0xFF);
+    SDL_RenderClear(m_Renderer);
+    SDL_RenderCopy(m_Renderer, m_Texture, NULL, &destination);
+    if (scaleMode == SCALE_CRT) {
+        SDL_RenderCopy(m_Renderer, m_Scanlines, NULL, &destination);
+    }
+}
+
+void FrameRenderer::DrawOverlay(const char* text, int scale) {
+    const int advance = 4 * scale;
+    const int margin = scale;
+
+    // Every lit font pixel is one rect, all drawn in a single call.
+    std::vector<SDL_Rect> pixels;
+    int length = 0;
+    for (; text[length]; length++) {
+        char c = (char)toupper((unsigned char)text[length]);
+        for (const auto& glyph : OVERLAY_FONT) {
+            if (glyph.c != c) {
+                continue;
+            }
+            for (int row = 0; row < 5; row++) {
+                for (int column = 0; column < 3; column++) {
+                    if ((glyph.rows[row] >> (2 - column)) & 1) {
+                        pixels.push_back({ margin * 2 + length * advance + column * scale, margin * 2 + row * scale, scale, scale });
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    SDL_Rect box = { margin, margin, length * advance + margin * 2 - scale, 5 * scale + margin * 2 };
+    SDL_SetRenderDrawBlendMode(m_Renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(m_Renderer, 0, 0, 0, 0xC0);
+    SDL_RenderFillRect(m_Renderer, &box);
+    SDL_SetRenderDrawColor(m_Renderer, 0x00, 0xFF, 0x00, 0xFF);
+    if (!pixels.empty()) {
+        SDL_RenderFillRects(m_Renderer, pixels.data(), (int)pixels.size());
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Renderer backend
+// The game screen is one persistent streaming texture at the CHIP-8's native resolution
+// (recreated if a SCHIP game switches to 128x64).
+// Each frame the 1-bit display is expanded into RGBA straight into the locked texture,
+// and the GPU does the upscale to the window size in SDL_RenderCopy. The window can be
+// any size; the ScaleMode decides how the screen is fitted into it.
+
+#include <SDL.h>
+#include <cstdint>
+
+// Native CHIP-8 resolution
+const int NATIVE_WIDTH = 64;
+const int NATIVE_HEIGHT = 32;
+
+// How the screen fills the window:
+//   SCALE_STRETCH - over the whole window, whatever its shape
+//   SCALE_FIT     - as big as fits with the CHIP-8's aspect ratio, black bars around it
+//   SCALE_INTEGER - like fit, but only whole multiples of the native size, so every pixel is the same size
+//   SCALE_CRT     - integer, with the bottom half of every row of pixels darkened like scanlines
+enum ScaleMode {
+    SCALE_STRETCH,
+    SCALE_FIT,
+    SCALE_INTEGER,
+    SCALE_CRT,
+};
+
+const char* ScaleModeName(ScaleMode mode);
+bool ParseScaleMode(const char* name, ScaleMode& mode);
+
+class FrameRenderer {
+public:
+    FrameRenderer() = default;
+    ~FrameRenderer();
+    FrameRenderer(const FrameRenderer&) = delete;
+    FrameRenderer& operator=(const FrameRenderer&) = delete;
+
+    bool Init(SDL_Renderer* renderer, int width, int height);
+
+    // Recreate the texture at a new size, on the same renderer
+    bool Resize(int width, int height) { return Init(m_Renderer, width, height); }
+    void Destroy();
+
+    // Lock rows [firstRow, firstRow + rowCount) of the texture for writing (all of it by
+    // default). Returns the first pixel of firstRow and sets pitch to the number of pixels
+    // (not bytes) per row. Every pixel in the locked rows must be written, since SDL
+    // doesn't promise to keep the old contents. Returns nullptr if the lock failed.
+    uint32_t* Lock(int& pitch, int firstRow = 0, int rowCount = -1);
+    void Unlock();
+
+    // Clear the window and copy the texture onto it as the scale mode says. Picks up
+    // window resizes by itself. Presenting is up to the caller.
+    void Draw();
+
+    ScaleMode scaleMode = SCALE_FIT;
+
+    // Draw a line of text over the top left corner of the window, on a dark box, with
+    // each font pixel scale window pixels wide. Knows digits, space, '.', ':' and the
+    // letters F, I, K, M, P, S and X; anything else comes out as a space. Call after Draw().
+    void DrawOverlay(const char* text, int scale = 4);
+
+    // RGBA8888 colors, indexed by (first plane lit) | (second plane lit) << 1. Anything
+    // that only uses the first plane is white on black.
+    uint32_t palette[4] = { 0x000000FF, 0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF };
+
+    int Width() const { return m_Width; }
+    int Height() const { return m_Height; }
+
+private:
+    // Where the screen goes in a window of the given size
+    SDL_Rect Destination(int windowWidth, int windowHeight) const;
+
+    // One texel column, two rows per screen row: the top clear, the bottom dark. Blended
+    // over the screen it darkens the bottom half of every CHIP-8 pixel.
+    bool CreateScanlines();
+
+    SDL_Renderer* m_Renderer = nullptr;
+    SDL_Texture* m_Texture = nullptr;
+    SDL_Texture* m_Scanlines = nullptr;
+    int m_Width = 0;
+    int m_Height = 0;
+};
@@ -0,0 +1,130 @@
+#include "Runner.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+ThreadPool::ThreadPool(int threads) : m_NextTask(0) {
+    if (threads <= 0) {
+        threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++) {
+        m_Workers.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_WakeWorkers.notify_all();
+    for (std::thread& worker : m_Workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Task = &task;
+    m_TaskCount = count;
+    m_NextTask = 0;
+    m_Busy = (int)m_Workers.size();
+    m_Generation++;
+    m_WakeWorkers.notify_all();
+
+    m_AllDone.wait(lock, [this] { return m_Busy == 0; });
+    m_Task = nullptr;
+}
+
+void ThreadPool::RunTasks() {
+
+    // Jobs are big (a whole machine run each), so handing them out one at a time is fine.
+    for (size_t i = m_NextTask++; i < m_TaskCount; i = m_NextTask++) {
+        (*m_Task)(i);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    uint64_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true) {
+        m_WakeWorkers.wait(lock, [&] { return m_Stopping || m_Generation != seenGeneration; });
+        if (m_Stopping) {
+            return;
+        }
+        seenGeneration = m_Generation;
+
+        lock.unlock();
+        RunTasks();
+        lock.lock();
+
+        if (--m_Busy == 0) {
+            m_AllDone.notify_all();
+        }
+    }
+}
+
+std::vector<MachineResult> RunMachines(const std::vector<MachineJob>& jobs, ThreadPool& pool,
+                                       const MachineResultCallback& onResult) {
+    std::vector<MachineResult> results(jobs.size());
+
+    pool.ParallelFor(jobs.size(), [&](size_t i) {
+        const MachineJob& job = jobs[i];
+        MachineResult& result = results[i];
+        if (!job.rom) {
+            if (onResult) {
+                onResult(i, result);
+            }
+            return;
+        }
+
+        std::unique_ptr<Chip8> machine(new Chip8());
+        machine->m_DispatchMode = job.dispatch;
+        machine->m_Quirks = job.quirks;
+        machine->m_RandomSeed = job.seed;
+        machine->m_SkipIdleLoops = job.skipIdleLoops;
+        machine->CPUReset(*job.rom);
+
+        FrameScheduler scheduler;
+        scheduler.Configure(job.instructionsPerSecond, true);
+        scheduler.Start();
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t frame = 0;
+        uint64_t stepped = 0;
+        for (; frame < job.frames && machine->m_Fault == FAULT_NONE; frame++) {
+            uint64_t instructions = (uint64_t)scheduler.InstructionsThisFrame();
+            if (job.instructionBudget != 0) {
+                if (stepped >= job.instructionBudget) {
+                    break;
+                }
+                instructions = std::min(instructions, job.instructionBudget - stepped);
+            }
+            uint64_t skippedBefore = machine->m_SkippedInstructions;
+            int ran = machine->RunInstructions((int)instructions);
+            stepped += ran;
+            result.instructions += ran - (machine->m_SkippedInstructions - skippedBefore);
+            machine->TickTimers();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        result.frames = frame;
+        result.fault = machine->m_Fault;
+        result.faultPC = machine->m_FaultPC;
+        result.unknownOpcodes = machine->m_UnknownOpcodes;
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.displayHash = machine->HashDisplay();
+        result.stateHash = machine->HashState();
+        if (onResult) {
+            onResult(i, result);
+        }
+    });
+
+    return results;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Batch runner
+// Runs many independent machines at once, spread over a pool of worker threads.
+// Each job gets its own Chip8, so nothing is shared except the (read-only) ROM images.
+
+#include "Chip8.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // threads <= 0 uses every core.
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls task(i) for every i in [0, count) across the workers and returns once all are done.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    int ThreadCount() const { return (int)m_Workers.size(); }
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeWorkers;
+    std::condition_variable m_AllDone;
+
+    // Bumped for every ParallelFor so sleeping workers know there's new work.
+    uint64_t m_Generation = 0;
+    int m_Busy = 0;
+    bool m_Stopping = false;
+
+    const std::function<void(size_t)>* m_Task = nullptr;
+    size_t m_TaskCount = 0;
+    std::atomic<size_t> m_NextTask;
+};
+
+struct MachineJob {
+    const ROMImage* rom = nullptr;
+
+    // How long to run for, in 60 Hz frames, and at most this many instructions (0 = no limit)
+    uint64_t frames = 60;
+    uint64_t instructionBudget = 0;
+    int instructionsPerSecond = 700;
+    DispatchMode dispatch = DefaultDispatchMode();
+    QuirkProfile quirks = QUIRKS_LEGACY;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+    bool skipIdleLoops = !MachineProfiler::enabled;
+};
+
+struct MachineResult {
+    // Instructions executed. Ones an idle loop skip jumped over aren't counted, though
+    // they still count against instructionBudget.
+    uint64_t instructions = 0;
+    uint64_t frames = 0;
+    uint64_t displayHash = 0;
+    uint64_t stateHash = 0;
+    uint64_t unknownOpcodes = 0;
+    double seconds = 0.0;
+    MachineFault fault = FAULT_NONE;
+    WORD faultPC = 0;
+};
+
+// Called on the worker thread as each job finishes, in whatever order they finish.
+// Calls can come from several workers at once.
+typedef std::function<void(size_t job, const MachineResult& result)> MachineResultCallback;
+
+// Run every job to completion on the pool. Results line up with jobs. Idle workers
+// take the next job as soon as they're done, so a few slow ROMs don't hold up the rest.
+std::vector<MachineResult> RunMachines(const std::vector<MachineJob>& jobs, ThreadPool& pool,
+                                       const MachineResultCallback& onResult = nullptr);
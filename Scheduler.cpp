@@ -0,0 +1,64 @@
+#include "Scheduler.h"
+#include <thread>
+
+// One 60 Hz frame
+static const FrameScheduler::Clock::duration FRAME_PERIOD =
+    std::chrono::duration_cast<FrameScheduler::Clock::duration>(std::chrono::nanoseconds(1000000000 / TIMER_HZ));
+
+// Sleep granularity can be poor (about 15 ms on Windows), so sleep until shortly
+// before the deadline and yield for the rest.
+static const std::chrono::milliseconds SPIN_MARGIN(2);
+
+// Falling further behind than this resets the schedule.
+static const int MAX_FRAMES_BEHIND = 5;
+
+void FrameScheduler::Configure(int instructionsPerSecond, bool unbounded) {
+    m_InstructionsPerSecond = instructionsPerSecond > 0 ? instructionsPerSecond : 1;
+    m_Unbounded = unbounded;
+    m_InstructionCredit = 0;
+}
+
+void FrameScheduler::SetSpeed(int speed) {
+    m_Speed = speed > 0 ? speed : 1;
+}
+
+void FrameScheduler::Start() {
+    m_NextDeadline = Clock::now();
+    m_FrameCount = 0;
+    m_InstructionCredit = 0;
+}
+
+int FrameScheduler::InstructionsThisFrame() {
+    m_InstructionCredit += m_InstructionsPerSecond;
+    int count = m_InstructionCredit / TIMER_HZ;
+    m_InstructionCredit -= count * TIMER_HZ;
+    return count;
+}
+
+void FrameScheduler::WaitForNextFrame() {
+    m_FrameCount++;
+    if (m_Unbounded) {
+        return;
+    }
+
+    const Clock::duration period = FRAME_PERIOD / m_Speed;
+    m_NextDeadline += period;
+    Clock::time_point now = Clock::now();
+
+    if (now - m_NextDeadline > period * MAX_FRAMES_BEHIND) {
+        m_NextDeadline = now;
+        return;
+    }
+
+    if (m_NextDeadline - now > SPIN_MARGIN) {
+        std::this_thread::sleep_until(m_NextDeadline - SPIN_MARGIN);
+    }
+    while (Clock::now() < m_NextDeadline) {
+        std::this_thread::yield();
+    }
+}
+
+void FrameScheduler::SkipWait() {
+    m_FrameCount++;
+    m_NextDeadline = Clock::now();
+}
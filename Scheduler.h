@@ -0,0 +1,56 @@
+#pragma once
+
+// Frame scheduler
+// The CHIP-8 timers run at exactly 60 Hz no matter how fast instructions execute, so
+// emulation is split into 60 Hz frames: run a batch of instructions, tick the timers,
+// present if anything changed, then wait for the next frame deadline.
+
+#include <chrono>
+#include <cstdint>
+
+const int TIMER_HZ = 60;
+
+class FrameScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // instructionsPerSecond sets how many instructions run per frame (fractions carry over).
+    // Unbounded runs frames back to back without ever sleeping, for batch runs.
+    void Configure(int instructionsPerSecond, bool unbounded);
+
+    // Start the clock. The first frame is due immediately.
+    void Start();
+
+    // How many instructions to run in the current frame.
+    int InstructionsThisFrame();
+
+    // Run speed times faster than real time: frames (and so the timers, and the
+    // instructions in them) come speed times as often. 1 is normal speed.
+    void SetSpeed(int speed);
+    int Speed() const { return m_Speed; }
+
+    // Sleep until the next 60 Hz deadline. Deadlines advance by a fixed period, so
+    // oversleeping one frame is made up in the next. If we fall hopelessly behind
+    // (e.g. the window was being dragged), the schedule is reset instead of fast-forwarding.
+    void WaitForNextFrame();
+
+    // Instead of WaitForNextFrame(), after the thread sat idle for a while: count the
+    // frame and make the next one due right away, without making up the time that went by.
+    void SkipWait();
+
+    int InstructionsPerSecond() const { return m_InstructionsPerSecond; }
+    bool IsUnbounded() const { return m_Unbounded; }
+    uint64_t FrameCount() const { return m_FrameCount; }
+
+private:
+    int m_InstructionsPerSecond = 700;
+    bool m_Unbounded = false;
+    int m_Speed = 1;
+
+    // Instructions per frame is rarely a whole number; the leftover accumulates here.
+    // Counted in 1/TIMER_HZ instruction units to stay exact.
+    int m_InstructionCredit = 0;
+
+    Clock::time_point m_NextDeadline;
+    uint64_t m_FrameCount = 0;
+};
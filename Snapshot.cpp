@@ -0,0 +1,230 @@
+#include "Snapshot.h"
+#include "JIT.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<MachineSnapshot>::value, "snapshots are copied with memcpy");
+
+void Chip8::SaveSnapshot(MachineSnapshot& snapshot) const {
+    memcpy(snapshot.display, m_Display.words, sizeof(snapshot.display));
+    memcpy(snapshot.secondPlane, m_SecondPlane.words, sizeof(snapshot.secondPlane));
+    snapshot.randomState = m_Random.state;
+    snapshot.randomIncrement = m_Random.increment;
+    memcpy(snapshot.stack, m_Stack.data(), sizeof(snapshot.stack));
+    snapshot.addressI = m_AddressI;
+    snapshot.pc = m_PC;
+    snapshot.faultPC = m_FaultPC;
+    snapshot.displayWidth = (WORD)m_Display.width;
+    snapshot.displayHeight = (WORD)m_Display.height;
+    memcpy(snapshot.memory, m_GameMemory.data(), sizeof(snapshot.memory));
+    memcpy(snapshot.registers, m_Registers.data(), sizeof(snapshot.registers));
+    memcpy(snapshot.keyboard, m_Keyboard.data(), sizeof(snapshot.keyboard));
+    memcpy(snapshot.flagRegisters, m_FlagRegisters.data(), sizeof(snapshot.flagRegisters));
+    memcpy(snapshot.audioPattern, m_AudioPattern.data(), sizeof(snapshot.audioPattern));
+    snapshot.sp = m_SP;
+    snapshot.delayTimer = delayTimer;
+    snapshot.soundTimer = soundTimer;
+    snapshot.fault = m_Fault;
+    snapshot.planeMask = m_PlaneMask;
+    snapshot.keyWait = m_KeyWait;
+    snapshot.audioPitch = m_AudioPitch;
+
+    // Zero whatever padding the compiler put after the last field, so two identical
+    // machines always give byte-identical snapshots.
+    const size_t end = offsetof(MachineSnapshot, audioPitch) + sizeof(snapshot.audioPitch);
+    memset(reinterpret_cast<BYTE*>(&snapshot) + end, 0, sizeof(MachineSnapshot) - end);
+}
+
+void Chip8::LoadSnapshot(const MachineSnapshot& snapshot) {
+    memcpy(m_Display.words, snapshot.display, sizeof(snapshot.display));
+    memcpy(m_SecondPlane.words, snapshot.secondPlane, sizeof(snapshot.secondPlane));
+    m_Random.state = snapshot.randomState;
+    m_Random.increment = snapshot.randomIncrement;
+    memcpy(m_Stack.data(), snapshot.stack, sizeof(snapshot.stack));
+    m_AddressI = snapshot.addressI;
+    m_PC = snapshot.pc;
+    m_FaultPC = snapshot.faultPC;
+    m_Display.width = m_SecondPlane.width = snapshot.displayWidth;
+    m_Display.height = m_SecondPlane.height = snapshot.displayHeight;
+    memcpy(m_GameMemory.data(), snapshot.memory, sizeof(snapshot.memory));
+    memcpy(m_Registers.data(), snapshot.registers, sizeof(snapshot.registers));
+    memcpy(m_Keyboard.data(), snapshot.keyboard, sizeof(snapshot.keyboard));
+    memcpy(m_FlagRegisters.data(), snapshot.flagRegisters, sizeof(snapshot.flagRegisters));
+    memcpy(m_AudioPattern.data(), snapshot.audioPattern, sizeof(snapshot.audioPattern));
+    m_SP = snapshot.sp;
+    delayTimer = snapshot.delayTimer;
+    soundTimer = snapshot.soundTimer;
+    m_Fault = (MachineFault)snapshot.fault;
+    m_PlaneMask = snapshot.planeMask;
+    m_KeyWait = snapshot.keyWait;
+    m_AudioPitch = snapshot.audioPitch;
+    m_Display.MarkAllDirty();
+    m_SecondPlane.MarkAllDirty();
+
+    // Memory was swapped out from under any compiled code.
+    if (m_JIT) {
+        m_JIT->Flush();
+    }
+}
+
+static void PutVarint(std::vector<BYTE>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((BYTE)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((BYTE)value);
+}
+
+static size_t GetVarint(const BYTE*& in) {
+    size_t value = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        value |= (size_t)(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (size_t)(*in++) << shift;
+    return value;
+}
+
+// The delta is a list of (bytes unchanged, bytes changed, the changed bytes XORed) runs.
+// Between two frames most of memory and the screen are untouched, so it's usually tiny.
+size_t EncodeSnapshotDelta(const MachineSnapshot& a, const MachineSnapshot& b, std::vector<BYTE>& out) {
+    const BYTE* pa = reinterpret_cast<const BYTE*>(&a);
+    const BYTE* pb = reinterpret_cast<const BYTE*>(&b);
+    const size_t size = sizeof(MachineSnapshot);
+
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        size_t same = i;
+        while (same < size && pa[same] == pb[same]) {
+            same++;
+        }
+        if (same == size) {
+            break;
+        }
+
+        // A short stretch of equal bytes costs more as a new run than as literals.
+        size_t changed = same;
+        while (changed < size && (pa[changed] != pb[changed] ||
+               (changed + 2 < size && (pa[changed + 1] != pb[changed + 1] || pa[changed + 2] != pb[changed + 2])))) {
+            changed++;
+        }
+
+        PutVarint(out, same - i);
+        PutVarint(out, changed - same);
+        for (size_t j = same; j < changed; j++) {
+            out.push_back(pa[j] ^ pb[j]);
+        }
+        i = changed;
+    }
+    return out.size();
+}
+
+void ApplySnapshotDelta(MachineSnapshot& snapshot, const BYTE* delta, size_t size) {
+    BYTE* target = reinterpret_cast<BYTE*>(&snapshot);
+    const BYTE* end = delta + size;
+    size_t position = 0;
+    while (delta < end) {
+        position += GetVarint(delta);
+        size_t changed = GetVarint(delta);
+        for (size_t j = 0; j < changed; j++) {
+            target[position++] ^= *delta++;
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer(size_t capacityBytes, int intervalFrames)
+    : m_Arena(capacityBytes), m_IntervalFrames(std::max(intervalFrames, 1)) {
+
+    // Worst case a delta is a little bigger than the snapshot itself.
+    m_Scratch.reserve(sizeof(MachineSnapshot) * 2);
+}
+
+void RewindBuffer::OnFrame(const Chip8& machine) {
+    if (m_FramesUntilSnapshot <= 0) {
+        Push(machine);
+        m_FramesUntilSnapshot = m_IntervalFrames;
+    }
+    m_FramesUntilSnapshot--;
+}
+
+void RewindBuffer::Push(const Chip8& machine) {
+    MachineSnapshot current;
+    machine.SaveSnapshot(current);
+
+    if (m_HasLatest) {
+        size_t size = EncodeSnapshotDelta(m_Latest, current, m_Scratch);
+        BYTE* target = Allocate(size);
+        if (target) {
+            memcpy(target, m_Scratch.data(), size);
+            m_Records.push_back({ (size_t)(target - m_Arena.data()), size });
+        }
+        else {
+
+            // Bigger than the whole arena; history can't reach past this point anymore.
+            m_Records.clear();
+            m_Head = 0;
+        }
+    }
+
+    m_Latest = current;
+    m_HasLatest = true;
+}
+
+bool RewindBuffer::Rewind(Chip8& machine, int steps) {
+    if (!m_HasLatest) {
+        return false;
+    }
+
+    for (int i = 0; i < steps && !m_Records.empty(); i++) {
+        const Record& record = m_Records.back();
+        ApplySnapshotDelta(m_Latest, &m_Arena[record.offset], record.size);
+        m_Head = record.offset;
+        m_Records.pop_back();
+    }
+
+    machine.LoadSnapshot(m_Latest);
+    m_FramesUntilSnapshot = m_IntervalFrames;
+    return true;
+}
+
+void RewindBuffer::Clear() {
+    m_Records.clear();
+    m_Head = 0;
+    m_HasLatest = false;
+    m_FramesUntilSnapshot = 0;
+}
+
+size_t RewindBuffer::BytesUsed() const {
+    size_t used = 0;
+    for (const Record& record : m_Records) {
+        used += record.size;
+    }
+    return used;
+}
+
+BYTE* RewindBuffer::Allocate(size_t size) {
+    if (size > m_Arena.size()) {
+        return nullptr;
+    }
+
+    // Records sit in the arena oldest to newest, starting right after m_Head. If we have
+    // to wrap around, everything between m_Head and the end goes first.
+    if (m_Head + size > m_Arena.size()) {
+        while (!m_Records.empty() && m_Records.front().offset >= m_Head) {
+            m_Records.pop_front();
+        }
+        m_Head = 0;
+    }
+
+    while (!m_Records.empty() && m_Records.front().offset >= m_Head && m_Records.front().offset < m_Head + size) {
+        m_Records.pop_front();
+    }
+
+    BYTE* target = m_Arena.data() + m_Head;
+    m_Head += size;
+    return target;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// Save states and rewind
+// A MachineSnapshot is a flat, trivially copyable copy of everything that makes up a
+// running machine, so capturing or restoring one is just a few memcpys. RewindBuffer
+// keeps a history of them in a single preallocated arena, each stored as a compressed
+// delta against the snapshot taken after it, so holding minutes of history is cheap.
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Fields are ordered largest first so there's no padding between them for deltas to trip over.
+struct MachineSnapshot {
+    uint64_t display[DISPLAY_MAX_WORDS];
+    uint64_t secondPlane[DISPLAY_MAX_WORDS];
+    uint64_t randomState;
+    uint64_t randomIncrement;
+    WORD stack[STACK_DEPTH];
+    WORD addressI;
+    WORD pc;
+    WORD faultPC;
+    WORD displayWidth;
+    WORD displayHeight;
+    BYTE memory[sizeof(Chip8::m_GameMemory)];
+    BYTE registers[16];
+    BYTE keyboard[16];
+    BYTE flagRegisters[16];
+    BYTE audioPattern[16];
+    BYTE sp;
+    BYTE delayTimer;
+    BYTE soundTimer;
+    BYTE fault;
+    BYTE planeMask;
+    BYTE keyWait;
+    BYTE audioPitch;
+};
+
+class RewindBuffer {
+public:
+    // capacityBytes is allocated once, up front. A snapshot is taken every intervalFrames frames.
+    explicit RewindBuffer(size_t capacityBytes = 4 * 1024 * 1024, int intervalFrames = 30);
+
+    // Call once per frame. Captures a snapshot whenever the interval comes around.
+    void OnFrame(const Chip8& machine);
+
+    // Capture a snapshot right now, regardless of the interval.
+    void Push(const Chip8& machine);
+
+    // Step back through history and restore the machine to it. Steps past the oldest
+    // snapshot stop there. Returns false if there's no history at all.
+    bool Rewind(Chip8& machine, int steps = 1);
+
+    void Clear();
+
+    // Snapshots that can still be rewound to, the newest one included.
+    size_t Depth() const { return m_HasLatest ? m_Records.size() + 1 : 0; }
+    size_t BytesUsed() const;
+
+private:
+    struct Record {
+        size_t offset;
+        size_t size;
+    };
+
+    // Reserve size contiguous bytes in the arena, dropping the oldest records in the way.
+    BYTE* Allocate(size_t size);
+
+    std::vector<BYTE> m_Arena;
+    size_t m_Head = 0;
+
+    // Oldest first. Each one turns the snapshot after it back into the one before.
+    std::deque<Record> m_Records;
+
+    MachineSnapshot m_Latest;
+    bool m_HasLatest = false;
+
+    int m_IntervalFrames;
+    int m_FramesUntilSnapshot = 0;
+
+    // Scratch space so recording never allocates
+    std::vector<BYTE> m_Scratch;
+};
+
+// XOR-then-run-length delta between two snapshots. Applying the delta to either one gives the other.
+size_t EncodeSnapshotDelta(const MachineSnapshot& a, const MachineSnapshot& b, std::vector<BYTE>& out);
+void ApplySnapshotDelta(MachineSnapshot& snapshot, const BYTE* delta, size_t size);
@@ -0,0 +1,115 @@
+#include "StateExport.h"
+#include "Log.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+StateExport::~StateExport() {
+    Close();
+}
+
+bool StateExport::Open(const char* fname) {
+    Close();
+
+    void* view = nullptr;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fname, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, sizeof(ExportedState), NULL);
+        if (mapping) {
+            view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(ExportedState));
+            if (view) {
+                m_FileHandle = file;
+                m_MappingHandle = mapping;
+            }
+            else {
+                CloseHandle(mapping);
+            }
+        }
+        if (!view) {
+            CloseHandle(file);
+        }
+    }
+#else
+    int fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (ftruncate(fd, sizeof(ExportedState)) == 0) {
+            view = mmap(nullptr, sizeof(ExportedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (view == MAP_FAILED) {
+                view = nullptr;
+            }
+        }
+
+        // The mapping stays valid after the descriptor is closed.
+        close(fd);
+    }
+#endif
+
+    if (!view) {
+        LOG_ERROR("Unable to map %s for the state export", fname);
+        return false;
+    }
+
+    // The file starts out zeroed, so the sequence counter starts at zero too.
+    m_State = static_cast<ExportedState*>(view);
+    memcpy(m_State->magic, "C8EX", sizeof(m_State->magic));
+    m_State->version = EXPORT_VERSION;
+    return true;
+}
+
+void StateExport::Close() {
+    if (!m_State) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_State);
+    CloseHandle(m_MappingHandle);
+    CloseHandle(m_FileHandle);
+    m_MappingHandle = nullptr;
+    m_FileHandle = nullptr;
+#else
+    munmap(m_State, sizeof(ExportedState));
+#endif
+    m_State = nullptr;
+}
+
+void StateExport::Publish(const Chip8& machine, uint64_t frame, uint64_t instructions) {
+    if (!m_State) {
+        return;
+    }
+    ExportedState& state = *m_State;
+
+    // Odd while writing. The fences keep the field writes between the two bumps.
+    uint32_t sequence = state.sequence.load(std::memory_order_relaxed);
+    state.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    state.frame = frame;
+    state.instructions = instructions;
+    state.pc = machine.m_PC;
+    state.addressI = machine.m_AddressI;
+    state.faultPC = machine.m_FaultPC;
+    state.displayWidth = (uint16_t)machine.m_Display.width;
+    state.displayHeight = (uint16_t)machine.m_Display.height;
+    memcpy(state.stack, machine.m_Stack.data(), sizeof(state.stack));
+    memcpy(state.registers, machine.m_Registers.data(), sizeof(state.registers));
+    state.sp = machine.m_SP;
+    state.delayTimer = machine.delayTimer;
+    state.soundTimer = machine.soundTimer;
+    state.fault = (uint8_t)machine.m_Fault;
+    state.quirks = (uint8_t)machine.m_Quirks;
+    state.planeMask = machine.m_PlaneMask;
+    state.waitingForKey = machine.IsWaitingForKey() ? 1 : 0;
+    memcpy(state.display, machine.m_Display.words, sizeof(state.display));
+    memcpy(state.secondPlane, machine.m_SecondPlane.words, sizeof(state.secondPlane));
+
+    state.sequence.store(sequence + 2, std::memory_order_release);
+}
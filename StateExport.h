@@ -0,0 +1,72 @@
+#pragma once
+
+// Live state export
+// With --export FILE the emulation thread keeps a snapshot of the machine in a file
+// mapped into memory (mmap, or a file mapping on Windows), refreshed once per frame.
+// A dashboard maps the same file and reads the registers, counters and both display
+// planes straight out of it, without ever talking to or pausing the emulator.
+//
+// The file is one ExportedState. Readers use the sequence counter like a seqlock:
+// read it, copy what they need, read it again. If it was odd, or changed, a frame was
+// being written meanwhile and the copy should be retried.
+
+#include "Chip8.h"
+#include <atomic>
+#include <cstdint>
+
+const uint32_t EXPORT_VERSION = 1;
+
+struct ExportedState {
+    char magic[4];                          // "C8EX"
+    uint32_t version;                       // EXPORT_VERSION
+    std::atomic<uint32_t> sequence;         // odd while a frame is being written
+    uint32_t reserved;
+
+    uint64_t frame;                         // 60 Hz frames run so far
+    uint64_t instructions;                  // instructions executed so far, skipped idle loops left out
+    uint16_t pc;
+    uint16_t addressI;
+    uint16_t faultPC;                       // valid when fault is set
+    uint16_t displayWidth;
+    uint16_t displayHeight;
+    uint16_t stack[STACK_DEPTH];
+    uint8_t registers[16];
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint8_t fault;                          // MachineFault
+    uint8_t quirks;                         // QuirkProfile
+    uint8_t planeMask;
+    uint8_t waitingForKey;                  // sitting in FX0A
+    uint8_t padding[7];
+
+    // DisplayPlane::words for each plane: rows of displayWidth / 64 words, most
+    // significant bit leftmost.
+    uint64_t display[DISPLAY_MAX_WORDS];
+    uint64_t secondPlane[DISPLAY_MAX_WORDS];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the sequence counter is shared with other processes");
+
+class StateExport {
+public:
+    StateExport() = default;
+    ~StateExport();
+    StateExport(const StateExport&) = delete;
+    StateExport& operator=(const StateExport&) = delete;
+
+    // Create (or truncate) the file and map it. Returns false if either fails.
+    bool Open(const char* fname);
+    void Close();
+
+    // Write the machine's state out. Emulation thread only, once a frame.
+    void Publish(const Chip8& machine, uint64_t frame, uint64_t instructions);
+
+private:
+    ExportedState* m_State = nullptr;
+
+#ifdef _WIN32
+    void* m_FileHandle = nullptr;
+    void* m_MappingHandle = nullptr;
+#endif
+};
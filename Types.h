@@ -0,0 +1,8 @@
+#pragma once
+
+// Documentation specifies that memory ranges from 0x000 -> 0x1FF, so negative values are not
+// needed. Opcodes are 1 word, or 2 bytes. 1 byte = 4 bits.
+// Rather than writing unsigned char or unsigned short int all the time, it's best to refer to
+// them as BYTE or WORD.
+typedef unsigned char BYTE;
+typedef unsigned short int WORD;